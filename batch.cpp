@@ -0,0 +1,183 @@
+#include "batch.hpp"
+#include "renderer.hpp"
+#include "framebuffer.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // Next whitespace separated field, or everything between a pair of double
+    // quotes, which has to be followed by whitespace or the end of the line.
+    bool ReadField(std::istream& fields, std::string& field)
+    {
+        fields >> std::ws;
+        if (fields.peek() != '"')
+            return static_cast<bool>(fields >> field);
+
+        fields.get();
+        if (!std::getline(fields, field, '"') || fields.eof())
+            return false;
+
+        const auto next = fields.peek();
+        return next == std::char_traits<char>::eof() || std::isspace(next);
+    }
+
+    // Whole field as a number; "61.5" is not a width of 61.
+    template <typename T>
+    bool ParseField(const std::string& field, T& value)
+    {
+        std::istringstream stream(field);
+        return (stream >> value) && (stream >> std::ws).eof();
+    }
+}
+
+std::vector<BatchJob> ReadManifest(const std::filesystem::path& path_to_manifest)
+{
+    std::ifstream manifest(path_to_manifest);
+    if (!manifest)
+        throw std::runtime_error("Failed to open manifest " + path_to_manifest.string());
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (size_t line_nr = 1; std::getline(manifest, line); ++line_nr)
+    {
+        std::istringstream fields(line);
+        fields >> std::ws;
+        if (fields.eof() || fields.peek() == '#')
+            continue;
+
+        std::array<std::string, 8> values;
+        std::string rest;
+        auto valid = std::all_of(values.begin(), values.end(), [&fields](auto& value) { return ReadField(fields, value); })
+            && !ReadField(fields, rest);
+
+        BatchJob job;
+        job.modelFilename = values[0];
+        job.textureFilename = values[1];
+        float_t x = 0.f;
+        float_t y = 0.f;
+        float_t z = 0.f;
+        valid = valid && ParseField(values[2], job.width) && ParseField(values[3], job.height)
+            && ParseField(values[4], x) && ParseField(values[5], y) && ParseField(values[6], z);
+        job.outputFilename = values[7];
+        if (!valid || job.width == 0 || job.height == 0)
+        {
+            throw std::runtime_error("Invalid job in manifest " + path_to_manifest.string()
+                + ", line " + std::to_string(line_nr));
+        }
+        job.lightVector = vec3f{ x, y, z };
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+AssetCache::AssetCache(ModelLoader model_loader, TextureLoader texture_loader)
+    : m_modelLoader(std::move(model_loader))
+    , m_textureLoader(std::move(texture_loader))
+{}
+
+template <typename T, typename Loader>
+std::shared_ptr<const T> AssetCache::Get(Entries<T>& entries, const Loader& loader, const std::string& path)
+{
+    std::promise<std::shared_ptr<const T>> promise;
+    std::shared_future<std::shared_ptr<const T>> asset;
+    bool loading = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto entry = entries.find(path);
+        if (entry != entries.end())
+        {
+            asset = entry->second;
+        }
+        else
+        {
+            asset = promise.get_future().share();
+            entries.emplace(path, asset);
+            loading = true;
+        }
+    }
+
+    // Waiting and loading both happen outside the lock, so different assets
+    // load in parallel and a job waiting for one doesn't hold up the rest.
+    if (!loading)
+        return asset.get();
+
+    try
+    {
+        promise.set_value(std::shared_ptr<const T>(loader(path)));
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+    }
+    return asset.get();
+}
+
+std::shared_ptr<const IModel> AssetCache::GetModel(const std::string& path)
+{
+    return Get(m_models, m_modelLoader, path);
+}
+
+std::shared_ptr<const Texture> AssetCache::GetTexture(const std::string& path)
+{
+    return Get(m_textures, m_textureLoader, path);
+}
+
+size_t RunBatch(const std::vector<BatchJob>& jobs, AssetCache& cache, const BatchOptions& options, std::ostream& log)
+{
+    std::atomic<size_t> next_job{ 0 };
+    std::atomic<size_t> failed{ 0 };
+    std::mutex log_mutex;
+
+    const auto worker = [&]() {
+        Renderer renderer;
+        renderer.SetThreadCount(options.threadsPerJob);
+        renderer.SetDeferredShading(options.deferred);
+        renderer.SetSampleCount(options.samples);
+        renderer.SetLevelOfDetail(options.lodError);
+        FrameBuffer out_image;
+        out_image.SetDepthFormat(options.depthFormat);
+
+        for (auto i = next_job++; i < jobs.size(); i = next_job++)
+        {
+            const auto& job = jobs[i];
+            try
+            {
+                const auto model = cache.GetModel(job.modelFilename);
+                const auto texture = cache.GetTexture(job.textureFilename);
+
+                out_image.CreateImage(job.width, job.height);
+                renderer.SetLightVector(job.lightVector);
+                renderer.RenderModel(*model, *texture, out_image);
+                out_image.WriteImage(job.outputFilename);
+            }
+            catch (const std::exception& e)
+            {
+                ++failed;
+                std::lock_guard<std::mutex> lock(log_mutex);
+                log << "Job " << i + 1 << " (" << job.outputFilename << ") failed: " << e.what() << std::endl;
+            }
+        }
+    };
+
+    const auto workers_nr = std::max<size_t>(1, std::min<size_t>(options.concurrentJobs, jobs.size()));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workers_nr; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    return failed;
+}
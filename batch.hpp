@@ -0,0 +1,77 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "depthformat.hpp"
+#include "model.hpp"
+#include "texture.hpp"
+#include "hola/hola.hpp"
+
+using namespace hola;
+
+// One line of a batch manifest:
+// <model> <texture> <width> <height> <light x> <light y> <light z> <output>
+// Fields are separated by whitespace; paths containing spaces are written in
+// double quotes. Lines starting with # are comments.
+struct BatchJob
+{
+    std::string modelFilename;
+    std::string textureFilename;
+    uint32_t width;
+    uint32_t height;
+    vec3f lightVector;
+    std::string outputFilename;
+};
+
+struct BatchOptions
+{
+    uint32_t concurrentJobs = 1;
+    uint32_t threadsPerJob = 1;
+    bool deferred = false;
+    DepthFormat depthFormat = DepthFormat::Float32;
+    uint32_t samples = 1;
+    // See Renderer::SetLevelOfDetail.
+    float_t lodError = 0.f;
+};
+
+std::vector<BatchJob> ReadManifest(const std::filesystem::path& path_to_manifest);
+
+// Loads every model and texture once, however many jobs refer to it. Jobs
+// asking for an asset that is still loading wait for that load instead of
+// starting their own.
+class AssetCache
+{
+public:
+    using ModelLoader = std::function<std::unique_ptr<IModel>(const std::string&)>;
+    using TextureLoader = std::function<std::unique_ptr<Texture>(const std::string&)>;
+
+    AssetCache(ModelLoader model_loader, TextureLoader texture_loader);
+
+    std::shared_ptr<const IModel> GetModel(const std::string& path);
+    std::shared_ptr<const Texture> GetTexture(const std::string& path);
+
+private:
+    template <typename T>
+    using Entries = std::map<std::string, std::shared_future<std::shared_ptr<const T>>>;
+
+    template <typename T, typename Loader>
+    std::shared_ptr<const T> Get(Entries<T>& entries, const Loader& loader, const std::string& path);
+
+    ModelLoader m_modelLoader;
+    TextureLoader m_textureLoader;
+    Entries<IModel> m_models;
+    Entries<Texture> m_textures;
+    std::mutex m_mutex;
+};
+
+// Runs jobs on up to options.concurrentJobs workers, each keeping one
+// Renderer and its z-buffer across jobs. Failed jobs are reported to log and
+// don't stop the rest; returns the number of failed jobs.
+size_t RunBatch(const std::vector<BatchJob>& jobs, AssetCache& cache, const BatchOptions& options, std::ostream& log);
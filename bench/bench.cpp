@@ -0,0 +1,706 @@
+#include "../renderer.hpp"
+#include "../tgaimpl.hpp"
+#include "../framebuffer.hpp"
+#include "../tgacodec.hpp"
+#include "../objimpl.hpp"
+#include "../meshlod.hpp"
+#include "../meshorder.hpp"
+#include "../texture.hpp"
+#include "../hola/hola.hpp"
+#include "../Clara/include/clara.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        bool help = false;
+        std::string filter;
+        std::string jsonFilename;
+        uint32_t warmup = 1;
+        uint32_t repetitions = 5;
+    };
+
+    // Work done by one iteration, turned into rates by the median time.
+    struct Work
+    {
+        double triangles = 0.0;
+        double pixels = 0.0;
+        double bytes = 0.0;
+        // Memory held by the data structure under test, not a rate.
+        double memory = 0.0;
+        // Vertex cache misses per triangle of the mesh under test, not a rate.
+        double cacheMissRatio = 0.0;
+    };
+
+    struct Result
+    {
+        std::string name;
+        Work work;
+        uint32_t repetitions;
+        double minSeconds;
+        double medianSeconds;
+    };
+
+    class BenchModel : public IModel
+    {
+        Mesh m_mesh;
+    public:
+        explicit BenchModel(Mesh mesh) : m_mesh(std::move(mesh)) {}
+
+        virtual void ReadModel(const std::filesystem::path&) override {}
+        virtual MeshView GetMesh() const override { return m_mesh.View(); }
+    };
+
+    constexpr size_t image_size = 1024;
+    constexpr float_t pi = 3.14159265359f;
+
+    void AddTriangle(Mesh& mesh, vec3f v0, vec3f v1, vec3f v2, const vec2f& t0, vec2f t1, vec2f t2)
+    {
+        // Front faces point towards +z, where the default light comes from.
+        if (get_z(cross(v1 - v0, v2 - v0)) < 0.f)
+        {
+            std::swap(v1, v2);
+            std::swap(t1, t2);
+        }
+
+        for (const auto& [position, uv] : { std::pair{ v0, t0 }, std::pair{ v1, t1 }, std::pair{ v2, t2 } })
+        {
+            mesh.positionIndices.push_back(static_cast<uint32_t>(mesh.positions.size()));
+            mesh.textureIndices.push_back(static_cast<uint32_t>(mesh.textureCoords.size()));
+            mesh.normalIndices.push_back(0);
+            mesh.positions.push_back(position);
+            mesh.textureCoords.push_back(uv);
+        }
+    }
+
+    Mesh FinishMesh(Mesh mesh)
+    {
+        mesh.normals.push_back(vec3f{ 0.f, 0.f, 0.f });
+        return mesh;
+    }
+
+    // Latitude/longitude grid; vertices are shared like in a real model.
+    Mesh SphereGrid(const uint32_t rings, const uint32_t segments)
+    {
+        Mesh mesh;
+        for (uint32_t r = 0; r <= rings; ++r)
+        {
+            for (uint32_t s = 0; s <= segments; ++s)
+            {
+                const auto theta = pi * r / rings;
+                const auto phi = 2.f * pi * s / segments;
+                const vec3f normal{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+                mesh.positions.push_back(normal * .9f);
+                mesh.normals.push_back(normal);
+                mesh.textureCoords.push_back(vec2f{ static_cast<float_t>(s) / segments, static_cast<float_t>(r) / rings });
+            }
+        }
+
+        const auto vertex = [segments](const uint32_t r, const uint32_t s) { return r * (segments + 1) + s; };
+        const auto add = [&mesh](const std::array<uint32_t, 3>& corners) {
+            auto v = corners;
+            const auto normal = cross(mesh.positions[v[1]] - mesh.positions[v[0]], mesh.positions[v[2]] - mesh.positions[v[0]]);
+            if (dot(normal, mesh.positions[v[0]]) < 0.f)
+                std::swap(v[1], v[2]);
+            for (const auto i : v)
+            {
+                mesh.positionIndices.push_back(i);
+                mesh.textureIndices.push_back(i);
+                mesh.normalIndices.push_back(i);
+            }
+        };
+        for (uint32_t r = 0; r < rings; ++r)
+        {
+            for (uint32_t s = 0; s < segments; ++s)
+            {
+                add({ vertex(r, s), vertex(r + 1, s), vertex(r + 1, s + 1) });
+                add({ vertex(r, s), vertex(r + 1, s + 1), vertex(r, s + 1) });
+            }
+        }
+        return FinishMesh(std::move(mesh));
+    }
+
+    // Same triangles in random order, like a scattered export.
+    Mesh ShuffleTriangles(Mesh mesh, const uint32_t seed)
+    {
+        std::vector<size_t> order(mesh.TriangleCount());
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+        Mesh shuffled = mesh;
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                shuffled.positionIndices[i * 3 + k] = mesh.positionIndices[order[i] * 3 + k];
+                shuffled.textureIndices[i * 3 + k] = mesh.textureIndices[order[i] * 3 + k];
+                shuffled.normalIndices[i * 3 + k] = mesh.normalIndices[order[i] * 3 + k];
+            }
+        }
+        return shuffled;
+    }
+
+    Mesh Slivers(const size_t count, const uint32_t seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> pos(-1.f, 1.f);
+        std::uniform_real_distribution<float> offset(-.004f, .004f);
+
+        Mesh mesh;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const vec3f a{ pos(gen), pos(gen), pos(gen) };
+            const vec3f b{ pos(gen), pos(gen), pos(gen) };
+            const vec3f c = a + vec3f{ offset(gen), offset(gen), 0.f };
+            AddTriangle(mesh, a, b, c, vec2f{ 0.f, 0.f }, vec2f{ 1.f, 0.f }, vec2f{ 0.f, 1.f });
+        }
+        return FinishMesh(std::move(mesh));
+    }
+
+    // Triangles far bigger than the screen, drawn at random depths.
+    Mesh HugeTriangles(const size_t count, const uint32_t seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> depth(-1.f, 1.f);
+
+        Mesh mesh;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto z = depth(gen);
+            AddTriangle(mesh, vec3f{ -3.f, -3.f, z }, vec3f{ 5.f, -3.f, z }, vec3f{ -3.f, 5.f, z },
+                vec2f{ 0.f, 0.f }, vec2f{ 1.f, 0.f }, vec2f{ 0.f, 1.f });
+        }
+        return FinishMesh(std::move(mesh));
+    }
+
+    // Full-screen quads stacked back to front, so every layer passes the
+    // depth test and gets shaded.
+    Mesh OverdrawStack(const size_t layers)
+    {
+        Mesh mesh;
+        for (size_t i = 0; i < layers; ++i)
+        {
+            const auto z = -1.f + 2.f * i / layers;
+            AddTriangle(mesh, vec3f{ -1.f, -1.f, z }, vec3f{ 1.f, -1.f, z }, vec3f{ 1.f, 1.f, z },
+                vec2f{ 0.f, 0.f }, vec2f{ 1.f, 0.f }, vec2f{ 1.f, 1.f });
+            AddTriangle(mesh, vec3f{ -1.f, -1.f, z }, vec3f{ 1.f, 1.f, z }, vec3f{ -1.f, 1.f, z },
+                vec2f{ 0.f, 0.f }, vec2f{ 1.f, 1.f }, vec2f{ 0.f, 1.f });
+        }
+        return FinishMesh(std::move(mesh));
+    }
+
+    TgaImage CheckerTexture(const Width width, const Height height)
+    {
+        TgaImage texture;
+        texture.CreateImage(width, height);
+        for (int32_t y = 0; y < static_cast<int32_t>(height); ++y)
+        {
+            for (int32_t x = 0; x < static_cast<int32_t>(width); ++x)
+            {
+                const auto v = static_cast<uint8_t>(((x / 16 + y / 16) % 2) ? 255 : 64);
+                texture.SetPixelColor(x, y, 1.f, TgaColor{ v, static_cast<uint8_t>(x), static_cast<uint8_t>(y) });
+            }
+        }
+        return texture;
+    }
+
+    // Screen-space copies of a mesh's triangles for RenderTriangle, with
+    // the area they cover on screen.
+    struct ScreenTriangles
+    {
+        std::vector<Triangle> triangles;
+        std::vector<TexCoords> textureCoords;
+        double area = 0.0;
+    };
+
+    ScreenTriangles ToScreen(const MeshView& mesh)
+    {
+        const auto to_screen = [](const vec3f& v) {
+            return vec3f{ std::round((get_x(v) + 1.f) * image_size / 2.f), std::round((get_y(v) + 1.f) * image_size / 2.f), get_z(v) };
+        };
+
+        ScreenTriangles screen;
+        for (size_t i = 0; i < mesh.TriangleCount(); ++i)
+        {
+            const auto polygon = mesh.GetPolygon(i);
+            const Triangle triangle{ to_screen(polygon.vertices[0]), to_screen(polygon.vertices[1]), to_screen(polygon.vertices[2]) };
+            screen.triangles.push_back(triangle);
+            screen.textureCoords.push_back(polygon.textureCoordinates);
+            screen.area += std::min(std::abs(get_z(cross(triangle[1] - triangle[0], triangle[2] - triangle[0]))) / 2.0,
+                static_cast<double>(image_size * image_size));
+        }
+        return screen;
+    }
+
+    class Bench
+    {
+        Options m_options;
+        std::vector<Result> m_results;
+
+    public:
+        explicit Bench(Options options) : m_options(std::move(options)) {}
+
+        void Run(const std::string& name, const Work& work, const std::function<void()>& iteration)
+        {
+            if (!m_options.filter.empty() && name.find(m_options.filter) == std::string::npos)
+                return;
+
+            for (uint32_t i = 0; i < m_options.warmup; ++i)
+            {
+                iteration();
+            }
+
+            std::vector<double> seconds;
+            for (uint32_t i = 0; i < std::max(1u, m_options.repetitions); ++i)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                iteration();
+                seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::sort(seconds.begin(), seconds.end());
+
+            const Result result{ name, work, static_cast<uint32_t>(seconds.size()), seconds.front(), seconds[seconds.size() / 2] };
+            m_results.push_back(result);
+            Print(result);
+        }
+
+        static void Print(const Result& result)
+        {
+            const auto rate = [&result](const double amount) { return amount / result.medianSeconds; };
+            std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(3)
+                << std::setw(10) << result.medianSeconds * 1e3 << " ms";
+            if (result.work.triangles > 0)
+                std::cout << std::setw(10) << std::setprecision(2) << rate(result.work.triangles) / 1e6 << " Mtri/s";
+            if (result.work.pixels > 0)
+                std::cout << std::setw(10) << std::setprecision(2) << rate(result.work.pixels) / 1e6 << " Mpx/s";
+            if (result.work.bytes > 0)
+                std::cout << std::setw(10) << std::setprecision(1) << rate(result.work.bytes) / 1e6 << " MB/s";
+            if (result.work.memory > 0)
+                std::cout << std::setw(10) << std::setprecision(2) << result.work.memory / (1 << 20) << " MiB";
+            if (result.work.cacheMissRatio > 0)
+                std::cout << std::setw(10) << std::setprecision(2) << result.work.cacheMissRatio << " ACMR";
+            std::cout << std::endl;
+        }
+
+        void WriteJson(const std::filesystem::path& path) const
+        {
+            std::ofstream out(path);
+            out << std::setprecision(9) << "{\n  \"benchmarks\": [";
+            for (size_t i = 0; i < m_results.size(); ++i)
+            {
+                const auto& result = m_results[i];
+                out << (i ? ",\n" : "\n") << "    {"
+                    << "\"name\": \"" << result.name << "\", "
+                    << "\"repetitions\": " << result.repetitions << ", "
+                    << "\"min_seconds\": " << result.minSeconds << ", "
+                    << "\"median_seconds\": " << result.medianSeconds << ", "
+                    << "\"triangles_per_second\": " << result.work.triangles / result.medianSeconds << ", "
+                    << "\"pixels_per_second\": " << result.work.pixels / result.medianSeconds << ", "
+                    << "\"bytes_per_second\": " << result.work.bytes / result.medianSeconds << ", "
+                    << "\"memory_bytes\": " << result.work.memory << ", "
+                    << "\"vertex_cache_miss_ratio\": " << result.work.cacheMissRatio << "}";
+            }
+            out << "\n  ]\n}\n";
+            if (!out.good())
+                throw std::runtime_error("Couldn't write " + path.string());
+        }
+    };
+
+    Options ParseCmdline(int argc, const char* argv[])
+    {
+        using namespace clara;
+
+        Options options;
+        auto cli =  Opt(options.filter, "substring")
+                        ["--filter"]
+                        ("Only run benchmarks whose name contains substring") |
+                    Opt(options.jsonFilename, "file")
+                        ["--json"]
+                        ("Write results as JSON") |
+                    Opt(options.warmup, "iterations")
+                        ["--warmup"]
+                        ("Untimed iterations before measuring") |
+                    Opt(options.repetitions, "iterations")
+                        ["--repetitions"]
+                        ("Timed iterations, the median is reported") |
+                    Opt(options.help)
+                        ["-?"]["--help"]
+                        ("Displays help");
+
+        auto result = cli.parse(Args(argc, argv));
+        if (!result)
+        {
+            std::cerr << "Error in command line: " << result.errorMessage() << std::endl;
+            std::exit(-1);
+        }
+
+        if (options.help)
+        {
+            std::cerr << cli << std::endl;
+            std::exit(-1);
+        }
+
+        return options;
+    }
+
+    void WriteObj(const MeshView& mesh, const std::filesystem::path& path)
+    {
+        std::ofstream out(path);
+        for (const auto& v : mesh.positions)
+            out << "v " << get_x(v) << ' ' << get_y(v) << ' ' << get_z(v) << '\n';
+        for (const auto& vt : mesh.textureCoords)
+            out << "vt " << get_x(vt) << ' ' << get_y(vt) << '\n';
+        for (size_t i = 0; i < mesh.positionIndices.size(); i += 3)
+        {
+            out << 'f';
+            for (size_t k = i; k < i + 3; ++k)
+                out << ' ' << mesh.positionIndices[k] + 1 << '/' << mesh.textureIndices[k] + 1;
+            out << '\n';
+        }
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    const auto options = ParseCmdline(argc, argv);
+    Bench bench(options);
+    const auto hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> thread_counts{ 1 };
+    if (hardware_threads > 1)
+        thread_counts.push_back(hardware_threads);
+    const auto directory = std::filesystem::temp_directory_path();
+
+    auto texture_image = CheckerTexture(512, 512);
+    const auto texels = std::as_const(texture_image).GetPixels();
+
+    const std::vector<std::pair<std::string, BenchModel>> models = [] {
+        std::vector<std::pair<std::string, BenchModel>> models;
+        models.emplace_back("sphere", BenchModel{ SphereGrid(256, 512) });
+        models.emplace_back("slivers", BenchModel{ Slivers(20000, 1) });
+        models.emplace_back("huge", BenchModel{ HugeTriangles(64, 2) });
+        models.emplace_back("overdraw", BenchModel{ OverdrawStack(32) });
+        return models;
+    }();
+
+    TgaImage out_image;
+    out_image.CreateImage(image_size, image_size);
+
+    for (const auto& [name, model] : models)
+    {
+        const auto screen = ToScreen(model.GetMesh());
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+        bench.Run("render_triangle/" + name, { static_cast<double>(screen.triangles.size()), screen.area, 0.0 }, [&]() {
+            renderer.ResetDepth(out_image.GetImageSize());
+            for (size_t i = 0; i < screen.triangles.size(); ++i)
+            {
+                renderer.RenderTriangle(screen.triangles[i], screen.textureCoords[i], 1.f, out_image, texture_image);
+            }
+        });
+    }
+
+    for (const auto mipmaps : { false, true })
+    {
+        const Texture texture(texels, mipmaps);
+        for (const auto& [name, model] : models)
+        {
+            for (const auto threads : thread_counts)
+            {
+                for (const auto deferred : { false, true })
+                {
+                    Renderer renderer;
+                    renderer.SetLightVector({ 0, 0, -1 });
+                    renderer.SetThreadCount(threads);
+                    renderer.SetDeferredShading(deferred);
+                    const auto triangles = static_cast<double>(model.GetMesh().TriangleCount());
+                    bench.Run("render_model/" + name + (mipmaps ? "/mipmap" : "") + "/threads:" + std::to_string(threads)
+                        + (deferred ? "/deferred" : ""), { triangles, static_cast<double>(image_size * image_size), 0.0 }, [&]() {
+                        renderer.RenderModel(model, texture, out_image);
+                    });
+                }
+            }
+        }
+    }
+
+    {
+        const Texture texture(texels);
+        const auto normal_map = std::make_shared<const Texture>(texels);
+        const auto& sphere = models.front().second;
+        const std::vector<std::pair<std::string, Shading>> shadings{
+            { "flat", Shading::Flat },
+            { "gouraud", Shading::Gouraud },
+            { "normal", Shading::NormalMapped },
+            { "depth", Shading::DepthOnly } };
+        for (const auto& shading : shadings)
+        {
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            renderer.SetShading(shading.second);
+            renderer.SetNormalMap(normal_map);
+            const auto triangles = static_cast<double>(sphere.GetMesh().TriangleCount());
+            bench.Run("render_model/sphere/shading:" + shading.first, { triangles, static_cast<double>(image_size * image_size), 0.0 }, [&]() {
+                renderer.RenderModel(sphere, texture, out_image);
+            });
+        }
+    }
+
+    {
+        const Texture texture(texels);
+        const auto& sphere = models.front().second;
+        const auto triangles = static_cast<double>(sphere.GetMesh().TriangleCount());
+        for (const auto threads : thread_counts)
+        {
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            renderer.SetThreadCount(threads);
+            FrameBuffer frame;
+            frame.CreateImage(image_size, image_size);
+            bench.Run("render_frame/sphere/threads:" + std::to_string(threads), { triangles, static_cast<double>(image_size * image_size), 0.0 }, [&]() {
+                frame.Clear();
+                renderer.RenderModel(sphere, texture, frame);
+            });
+        }
+
+        const std::vector<std::pair<std::string, DepthFormat>> depth_formats{
+            { "float", DepthFormat::Float32 },
+            { "16", DepthFormat::Unorm16 },
+            { "24", DepthFormat::Unorm24 },
+            { "compressed", DepthFormat::Compressed } };
+        for (const auto& [name, model] : { models[0], models[3] })
+        {
+            for (const auto& depth_format : depth_formats)
+            {
+                Renderer renderer;
+                renderer.SetLightVector({ 0, 0, -1 });
+                FrameBuffer frame;
+                frame.SetDepthFormat(depth_format.second);
+                frame.CreateImage(image_size, image_size);
+                renderer.RenderModel(model, texture, frame);
+                Work work{ static_cast<double>(model.GetMesh().TriangleCount()), static_cast<double>(image_size * image_size), 0.0,
+                    static_cast<double>(frame.Depth().MemoryBytes()) };
+                bench.Run("render_frame/" + name + "/depth:" + depth_format.first, work, [&]() {
+                    frame.Clear();
+                    renderer.RenderModel(model, texture, frame);
+                });
+            }
+        }
+
+        // Anti-aliasing by multisampling, against the old way of rendering at
+        // twice the size and averaging every 2x2 block.
+        for (const uint32_t samples : { 1u, 4u, 8u })
+        {
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            renderer.SetSampleCount(samples);
+            bench.Run("render_antialiased/sphere/msaa:" + std::to_string(samples), { triangles, static_cast<double>(image_size * image_size), 0.0 }, [&]() {
+                renderer.RenderModel(sphere, texture, out_image);
+            });
+        }
+        {
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            TgaImage supersampled;
+            supersampled.CreateImage(2 * image_size, 2 * image_size);
+            bench.Run("render_antialiased/sphere/supersampled:4", { triangles, static_cast<double>(image_size * image_size), 0.0 }, [&]() {
+                renderer.RenderModel(sphere, texture, supersampled);
+                const auto source = std::as_const(supersampled).GetPixels();
+                const auto target = out_image.GetPixels();
+                for (size_t y = 0; y < image_size; ++y)
+                {
+                    for (size_t x = 0; x < image_size; ++x)
+                    {
+                        const auto top = source.Pixel(static_cast<int32_t>(2 * x), static_cast<int32_t>(2 * y));
+                        const auto bottom = top + source.width * source.bytesPerPixel;
+                        const auto pixel = target.Pixel(static_cast<int32_t>(x), static_cast<int32_t>(y));
+                        for (size_t c = 0; c < target.bytesPerPixel; ++c)
+                        {
+                            const auto next = c + source.bytesPerPixel;
+                            pixel[c] = static_cast<uint8_t>((top[c] + top[next] + bottom[c] + bottom[next] + 2) / 4);
+                        }
+                    }
+                }
+            });
+        }
+
+        // Memory is what one band holds, colour and depth; bands are dropped
+        // rather than written.
+        for (const Height band_height : { Height{ 64 }, Height{ 256 }, Height{ image_size } })
+        {
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            FrameBuffer band;
+            const ImageSize size{ image_size, image_size };
+            renderer.RenderModelInBands(sphere, texture, size, band_height, band, [](const ConstPixelView&) {});
+            Work work{ triangles, static_cast<double>(image_size * image_size), 0.0,
+                static_cast<double>(image_size * band_height * 3 + band.Depth().MemoryBytes()) };
+            bench.Run("render_bands/sphere/rows:" + std::to_string(band_height), work, [&]() {
+                renderer.RenderModelInBands(sphere, texture, size, band_height, band, [](const ConstPixelView&) {});
+            });
+        }
+
+        // Thumbnails with the full mesh and with the level whose error stays
+        // within half a pixel. Building the levels is paid once at load.
+        bench.Run("build_lod/sphere", { triangles, 0.0, 0.0 }, [&]() { BuildMeshLevels(sphere.GetMesh()); });
+        LodModel lod_sphere(std::make_unique<BenchModel>(SphereGrid(256, 512)));
+        lod_sphere.ReadModel({});
+        for (const Width thumbnail_size : { Width{ 64 }, Width{ 256 } })
+        {
+            TgaImage thumbnail;
+            thumbnail.CreateImage(thumbnail_size, thumbnail_size);
+            for (const auto lod_error : { 0.f, .5f })
+            {
+                Renderer renderer;
+                renderer.SetLightVector({ 0, 0, -1 });
+                renderer.SetLevelOfDetail(lod_error);
+                const auto level_triangles = renderer.SelectMesh(lod_sphere, thumbnail.GetImageSize()).TriangleCount();
+                bench.Run("render_thumbnail/sphere/size:" + std::to_string(thumbnail_size) + (lod_error > 0.f ? "/lod" : ""),
+                    { static_cast<double>(level_triangles), static_cast<double>(thumbnail_size * thumbnail_size), 0.0 }, [&]() {
+                    renderer.RenderModel(lod_sphere, texture, thumbnail);
+                });
+            }
+        }
+
+        // The sphere as generated, with its triangles scattered like some
+        // exporters leave them, and after the load-time reordering pass.
+        const BenchModel shuffled{ ShuffleTriangles(SphereGrid(256, 512), 1) };
+        bench.Run("reorder_mesh/sphere", { triangles, 0.0, 0.0 }, [&]() { ReorderMesh(shuffled.GetMesh()); });
+        const BenchModel reordered{ ReorderMesh(shuffled.GetMesh()) };
+        const std::vector<std::pair<std::string, const BenchModel*>> orders{
+            { "generated", &sphere },
+            { "shuffled", &shuffled },
+            { "reordered", &reordered } };
+        for (const auto& [order, model] : orders)
+        {
+            for (const auto threads : thread_counts)
+            {
+                Renderer renderer;
+                renderer.SetLightVector({ 0, 0, -1 });
+                renderer.SetThreadCount(threads);
+                Work work{ triangles, static_cast<double>(image_size * image_size), 0.0 };
+                work.cacheMissRatio = VertexCacheMissRatio(model->GetMesh());
+                bench.Run("render_model/sphere/order:" + order + "/threads:" + std::to_string(threads), work, [&]() {
+                    renderer.RenderModel(*model, texture, out_image);
+                });
+            }
+        }
+
+        const Work work{ 0.0, static_cast<double>(image_size * image_size), 0.0 };
+        TgaImage image;
+        bench.Run("create_image/tga", work, [&]() { image.CreateImage(image_size, image_size); });
+        FrameBuffer frame;
+        bench.Run("create_image/framebuffer", work, [&]() { frame.CreateImage(image_size, image_size); });
+    }
+
+    {
+        std::mt19937 gen(3);
+        std::uniform_int_distribution<int> pos(0, image_size - 1);
+        std::vector<std::pair<vec2i, vec2i>> lines(20000);
+        double pixels = 0.0;
+        for (auto& line : lines)
+        {
+            line = { vec2i{ pos(gen), pos(gen) }, vec2i{ pos(gen), pos(gen) } };
+            pixels += std::max(std::abs(get_x(line.second) - get_x(line.first)), std::abs(get_y(line.second) - get_y(line.first)));
+        }
+
+        Renderer renderer;
+        const TgaColor white{ 255, 255, 255 };
+        bench.Run("render_line", { 0.0, pixels, 0.0 }, [&]() {
+            for (const auto& [from, to] : lines)
+            {
+                renderer.RenderLine(from, to, out_image, white);
+            }
+        });
+    }
+
+    {
+        std::mt19937 gen(4);
+        std::uniform_real_distribution<float> weight(0.f, 1.f);
+        std::vector<vec3f> barycentrics(1 << 20);
+        for (auto& b : barycentrics)
+        {
+            const auto u = weight(gen);
+            const auto v = weight(gen) * (1.f - u);
+            b = vec3f{ u, v, 1.f - u - v };
+        }
+        const TexCoords texture_coords{ vec2f{ 0.f, 0.f }, vec2f{ 1.f, 0.f }, vec2f{ 0.f, 1.f } };
+
+        Renderer renderer;
+        bench.Run("texture_sample/image", { 0.0, static_cast<double>(barycentrics.size()), 0.0 }, [&]() {
+            uint32_t sum = 0;
+            for (const auto& b : barycentrics)
+                sum += renderer.GetColorFromTexture(b, texture_coords, texels).r;
+            volatile auto sink = sum;
+            (void)sink;
+        });
+
+        for (const auto filter : { TextureFilter::Nearest, TextureFilter::Bilinear })
+        {
+            const Texture texture(texels, true, filter);
+            for (const size_t level : { size_t{ 0 }, size_t{ 2 } })
+            {
+                bench.Run(std::string("texture_sample/") + (filter == TextureFilter::Nearest ? "nearest" : "bilinear")
+                    + "/level:" + std::to_string(level), { 0.0, static_cast<double>(barycentrics.size()), 0.0 }, [&]() {
+                    uint32_t sum = 0;
+                    for (const auto& b : barycentrics)
+                        sum += texture.Sample(b, texture_coords, level).r;
+                    volatile auto sink = sum;
+                    (void)sink;
+                });
+            }
+        }
+    }
+
+    {
+        const auto obj_path = directory / "renderer_bench_sphere.obj";
+        WriteObj(models.front().second.GetMesh(), obj_path);
+        const Work work{ static_cast<double>(models.front().second.GetMesh().TriangleCount()), 0.0,
+            static_cast<double>(std::filesystem::file_size(obj_path)) };
+
+        for (const auto threads : thread_counts)
+        {
+            bench.Run("obj_load/mapped/threads:" + std::to_string(threads), work, [&]() {
+                MappedObj obj(threads);
+                obj.ReadModel(obj_path);
+            });
+        }
+        bench.Run("obj_load/tinyobj", work, [&]() {
+            Obj obj;
+            obj.ReadModel(obj_path);
+        });
+    }
+
+    {
+        TgaImage frame;
+        frame.CreateImage(4096, 4096);
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+        renderer.SetThreadCount(hardware_threads);
+        renderer.RenderModel(models.front().second, Texture(texels), frame);
+
+        const auto tga_path = directory / "renderer_bench_frame.tga";
+        const Work work{ 0.0, 4096.0 * 4096.0, 4096.0 * 4096.0 * 3.0 };
+        bench.Run("tga_write", work, [&]() { frame.WriteImage(tga_path); });
+        bench.Run("tga_read", work, [&]() {
+            TgaImage image;
+            image.ReadImage(tga_path);
+        });
+    }
+
+    if (!options.jsonFilename.empty())
+        bench.WriteJson(options.jsonFilename);
+
+    return 0;
+}
@@ -0,0 +1,256 @@
+#include "binarymesh.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static_assert(sizeof(vec3f) == 3 * sizeof(float_t), "vec3f must be three packed floats");
+static_assert(sizeof(vec2f) == 2 * sizeof(float_t), "vec2f must be two packed floats");
+
+namespace
+{
+    constexpr char binary_mesh_magic[8] = { 'W', 'E', 'E', 'M', 'E', 'S', 'H', '\0' };
+    constexpr uint32_t binary_mesh_version = 2;
+    constexpr uint64_t block_alignment = 64;
+    constexpr std::array<uint64_t, BinaryMeshHeader::BlockCount> element_sizes = {
+        sizeof(vec3f), sizeof(vec2f), sizeof(vec3f), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t),
+        sizeof(BinaryMeshLevel), sizeof(vec3f), sizeof(uint32_t) };
+
+    bool IsLittleEndian()
+    {
+        const uint16_t value = 1;
+        uint8_t first_byte;
+        std::memcpy(&first_byte, &value, 1);
+        return first_byte == 1;
+    }
+
+    // 64-bit FNV-1a over words with an extra fold, chained through seed.
+    uint64_t Checksum(const char* data, const size_t size, uint64_t seed)
+    {
+        constexpr uint64_t prime = 1099511628211ull;
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            seed = (seed ^ word) * prime;
+            seed ^= seed >> 32;
+        }
+        for (; i < size; ++i)
+        {
+            seed = (seed ^ static_cast<uint8_t>(data[i])) * prime;
+        }
+        return seed;
+    }
+
+    constexpr uint64_t checksum_seed = 14695981039346656037ull;
+
+    uint64_t HeaderChecksum(const BinaryMeshHeader& header)
+    {
+        return Checksum(reinterpret_cast<const char*>(&header),
+            offsetof(BinaryMeshHeader, headerChecksum), checksum_seed);
+    }
+
+    uint64_t AlignUp(const uint64_t value)
+    {
+        return (value + block_alignment - 1) / block_alignment * block_alignment;
+    }
+
+    bool IndicesInRange(const MeshView& mesh)
+    {
+        const auto in_range = [](const ArrayView<uint32_t>& indices, const size_t count) {
+            return std::all_of(indices.begin(), indices.end(), [count](const uint32_t i) { return i < count; });
+        };
+        return in_range(mesh.positionIndices, mesh.positions.size())
+            && in_range(mesh.textureIndices, mesh.textureCoords.size())
+            && in_range(mesh.normalIndices, mesh.normals.size());
+    }
+
+    [[noreturn]] void ThrowInvalid(const std::filesystem::path& path, const char* reason)
+    {
+        throw std::runtime_error("Invalid mesh cache " + path.string() + ": " + reason);
+    }
+}
+
+void WriteBinaryMesh(const MeshView& mesh, const std::filesystem::path& path_to_write,
+    const ArrayView<MeshLevel>& levels)
+{
+    if (!IsLittleEndian())
+        throw std::runtime_error("Mesh cache can only be written on little-endian hosts");
+
+    std::vector<BinaryMeshLevel> level_records;
+    std::vector<vec3f> level_positions;
+    std::vector<uint32_t> level_indices;
+    for (const auto& level : levels)
+    {
+        if (level.mesh.textureCoords.data != mesh.textureCoords.data || level.mesh.normals.data != mesh.normals.data)
+            throw std::runtime_error("Mesh levels must share texture coordinates and normals with the mesh");
+
+        level_records.push_back({ level.mesh.positions.size(), level.mesh.positionIndices.size(), level.error, 0 });
+        level_positions.insert(level_positions.end(), level.mesh.positions.begin(), level.mesh.positions.end());
+        for (const auto& indices : { level.mesh.positionIndices, level.mesh.textureIndices, level.mesh.normalIndices })
+        {
+            level_indices.insert(level_indices.end(), indices.begin(), indices.end());
+        }
+    }
+
+    const std::array<const char*, BinaryMeshHeader::BlockCount> blocks = {
+        reinterpret_cast<const char*>(mesh.positions.data),
+        reinterpret_cast<const char*>(mesh.textureCoords.data),
+        reinterpret_cast<const char*>(mesh.normals.data),
+        reinterpret_cast<const char*>(mesh.positionIndices.data),
+        reinterpret_cast<const char*>(mesh.textureIndices.data),
+        reinterpret_cast<const char*>(mesh.normalIndices.data),
+        reinterpret_cast<const char*>(level_records.data()),
+        reinterpret_cast<const char*>(level_positions.data()),
+        reinterpret_cast<const char*>(level_indices.data()) };
+
+    BinaryMeshHeader header{};
+    std::memcpy(header.magic, binary_mesh_magic, sizeof(header.magic));
+    header.version = binary_mesh_version;
+    header.headerSize = sizeof(BinaryMeshHeader);
+    header.counts[BinaryMeshHeader::Positions] = mesh.positions.size();
+    header.counts[BinaryMeshHeader::TextureCoords] = mesh.textureCoords.size();
+    header.counts[BinaryMeshHeader::Normals] = mesh.normals.size();
+    header.counts[BinaryMeshHeader::PositionIndices] = mesh.positionIndices.size();
+    header.counts[BinaryMeshHeader::TextureIndices] = mesh.textureIndices.size();
+    header.counts[BinaryMeshHeader::NormalIndices] = mesh.normalIndices.size();
+    header.counts[BinaryMeshHeader::Levels] = level_records.size();
+    header.counts[BinaryMeshHeader::LevelPositions] = level_positions.size();
+    header.counts[BinaryMeshHeader::LevelIndices] = level_indices.size();
+
+    auto offset = AlignUp(sizeof(BinaryMeshHeader));
+    header.payloadChecksum = checksum_seed;
+    for (size_t block = 0; block < BinaryMeshHeader::BlockCount; ++block)
+    {
+        const auto size = header.counts[block] * element_sizes[block];
+        header.offsets[block] = offset;
+        header.payloadChecksum = Checksum(blocks[block], size, header.payloadChecksum);
+        offset = AlignUp(offset + size);
+    }
+    header.headerChecksum = HeaderChecksum(header);
+
+    std::ofstream out(path_to_write, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("Couldn't save file");
+
+    const char padding[block_alignment] = {};
+    uint64_t written = 0;
+    const auto write = [&out, &written](const char* data, const uint64_t size) {
+        out.write(data, static_cast<std::streamsize>(size));
+        written += size;
+    };
+
+    write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t block = 0; block < BinaryMeshHeader::BlockCount; ++block)
+    {
+        if (header.counts[block] == 0)
+            continue;
+
+        write(padding, header.offsets[block] - written);
+        write(blocks[block], header.counts[block] * element_sizes[block]);
+    }
+
+    if (!out)
+        throw std::runtime_error("Couldn't save file");
+}
+
+void BinaryModel::ReadModel(const std::filesystem::path& path_to_model)
+{
+    if (path_to_model.extension() != ".bmesh")
+        throw std::runtime_error("Invalid file provided, should be .bmesh");
+    if (!IsLittleEndian())
+        throw std::runtime_error("Mesh cache can only be read on little-endian hosts");
+
+    auto file = std::make_unique<MappedFile>(path_to_model);
+    if (file->Size() < sizeof(BinaryMeshHeader))
+        ThrowInvalid(path_to_model, "file too short");
+
+    BinaryMeshHeader header;
+    std::memcpy(&header, file->Data(), sizeof(header));
+    if (std::memcmp(header.magic, binary_mesh_magic, sizeof(header.magic)) != 0)
+        ThrowInvalid(path_to_model, "bad magic");
+    if (header.version != binary_mesh_version || header.headerSize != sizeof(BinaryMeshHeader))
+        ThrowInvalid(path_to_model, "unsupported version");
+    if (header.headerChecksum != HeaderChecksum(header))
+        ThrowInvalid(path_to_model, "header checksum mismatch");
+
+    const auto index_count = header.counts[BinaryMeshHeader::PositionIndices];
+    if (index_count % 3 != 0
+        || header.counts[BinaryMeshHeader::TextureIndices] != index_count
+        || header.counts[BinaryMeshHeader::NormalIndices] != index_count)
+        ThrowInvalid(path_to_model, "index blocks don't describe triangles");
+
+    for (size_t block = 0; block < BinaryMeshHeader::BlockCount; ++block)
+    {
+        const auto offset = header.offsets[block];
+        const auto count = header.counts[block];
+        // Empty blocks after the last one start past the end of the file.
+        if (offset % block_alignment != 0
+            || (count > 0 && (offset > file->Size() || count > (file->Size() - offset) / element_sizes[block])))
+            ThrowInvalid(path_to_model, "block outside of file");
+    }
+
+    const auto block_data = [&header, &file](const BinaryMeshHeader::Block block) -> const char* {
+        return header.counts[block] > 0 ? file->Data() + header.offsets[block] : nullptr;
+    };
+
+    MeshView mesh{
+        { reinterpret_cast<const vec3f*>(block_data(BinaryMeshHeader::Positions)), header.counts[BinaryMeshHeader::Positions] },
+        { reinterpret_cast<const vec2f*>(block_data(BinaryMeshHeader::TextureCoords)), header.counts[BinaryMeshHeader::TextureCoords] },
+        { reinterpret_cast<const vec3f*>(block_data(BinaryMeshHeader::Normals)), header.counts[BinaryMeshHeader::Normals] },
+        { reinterpret_cast<const uint32_t*>(block_data(BinaryMeshHeader::PositionIndices)), index_count },
+        { reinterpret_cast<const uint32_t*>(block_data(BinaryMeshHeader::TextureIndices)), index_count },
+        { reinterpret_cast<const uint32_t*>(block_data(BinaryMeshHeader::NormalIndices)), index_count } };
+
+    // Levels are checked against the blocks holding them as they are laid out.
+    std::vector<MeshLevel> levels;
+    const auto records = reinterpret_cast<const BinaryMeshLevel*>(block_data(BinaryMeshHeader::Levels));
+    auto level_positions = reinterpret_cast<const vec3f*>(block_data(BinaryMeshHeader::LevelPositions));
+    auto level_indices = reinterpret_cast<const uint32_t*>(block_data(BinaryMeshHeader::LevelIndices));
+    uint64_t positions_left = header.counts[BinaryMeshHeader::LevelPositions];
+    uint64_t indices_left = header.counts[BinaryMeshHeader::LevelIndices];
+    for (size_t i = 0; i < header.counts[BinaryMeshHeader::Levels]; ++i)
+    {
+        BinaryMeshLevel record;
+        std::memcpy(&record, records + i, sizeof(record));
+        if (record.indexCount % 3 != 0 || record.positionCount > positions_left || record.indexCount > indices_left / 3)
+            ThrowInvalid(path_to_model, "levels outside of their blocks");
+
+        const auto count = record.indexCount;
+        levels.push_back({ { { level_positions, record.positionCount },
+            mesh.textureCoords,
+            mesh.normals,
+            { level_indices, count },
+            { level_indices + count, count },
+            { level_indices + 2 * count, count } }, record.error });
+        level_positions += record.positionCount;
+        level_indices += 3 * count;
+        positions_left -= record.positionCount;
+        indices_left -= 3 * count;
+    }
+
+    if (m_verifyPayload)
+    {
+        auto checksum = checksum_seed;
+        for (size_t block = 0; block < BinaryMeshHeader::BlockCount; ++block)
+        {
+            checksum = Checksum(block_data(static_cast<BinaryMeshHeader::Block>(block)),
+                header.counts[block] * element_sizes[block], checksum);
+        }
+        if (checksum != header.payloadChecksum)
+            ThrowInvalid(path_to_model, "payload checksum mismatch");
+    }
+
+    // Unlike the checksum this is always checked: a bad index would be read
+    // out of bounds while rendering rather than fail here.
+    if (!IndicesInRange(mesh)
+        || !std::all_of(levels.begin(), levels.end(), [](const MeshLevel& level) { return IndicesInRange(level.mesh); }))
+        ThrowInvalid(path_to_model, "index out of range");
+
+    m_file = std::move(file);
+    m_mesh = mesh;
+    m_levels = std::move(levels);
+}
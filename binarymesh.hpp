@@ -0,0 +1,67 @@
+#pragma once
+
+#include "model.hpp"
+#include "mappedfile.hpp"
+#include <memory>
+#include <vector>
+
+// Versioned binary mesh cache (.bmesh). All values are little-endian. The
+// header is followed by the position, texture coordinate and normal blocks
+// and the three index blocks, each starting on a 64 byte boundary so it can
+// be used in place straight from a file mapping. Simplified levels follow
+// the mesh: one record per level, then the positions of every level and
+// their position, texture and normal indices, one level after the other.
+struct BinaryMeshHeader
+{
+    enum Block
+    {
+        Positions,
+        TextureCoords,
+        Normals,
+        PositionIndices,
+        TextureIndices,
+        NormalIndices,
+        Levels,
+        LevelPositions,
+        LevelIndices,
+        BlockCount
+    };
+
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t counts[BlockCount];
+    uint64_t offsets[BlockCount];
+    uint64_t payloadChecksum;
+    uint64_t headerChecksum;
+};
+
+struct BinaryMeshLevel
+{
+    uint64_t positionCount;
+    uint64_t indexCount;
+    float_t error;
+    uint32_t reserved;
+};
+
+// Levels must share texture coordinates and normals with mesh.
+void WriteBinaryMesh(const MeshView& mesh, const std::filesystem::path& path_to_write,
+    const ArrayView<MeshLevel>& levels = {});
+
+// Maps a .bmesh file and exposes its blocks without parsing or copying. The
+// header checksum and index ranges are always verified, so a damaged cache
+// fails to load rather than being read out of bounds; verifying the payload
+// checksum reads the whole file and is optional.
+class BinaryModel : public IModel
+{
+    std::unique_ptr<MappedFile> m_file;
+    MeshView m_mesh;
+    std::vector<MeshLevel> m_levels;
+    bool m_verifyPayload;
+public:
+    explicit BinaryModel(const bool verify_payload = false) : m_verifyPayload(verify_payload) {}
+
+    virtual void ReadModel(const std::filesystem::path& path_to_model) override;
+    virtual MeshView GetMesh() const override { return m_mesh; }
+    virtual ArrayView<MeshLevel> GetLevels() const override { return { m_levels.data(), m_levels.size() }; }
+};
@@ -0,0 +1,64 @@
+#include "compresseddepth.hpp"
+#include <algorithm>
+
+void CompressedDepth::Reset(const Width width, const Height height)
+{
+    m_tilesX = (width + tile_size - 1) >> tile_shift;
+    const auto tiles_y = (height + tile_size - 1) >> tile_shift;
+    m_tiles.assign(m_tilesX * tiles_y, Tile{});
+    m_chunks.resize(std::max(m_chunks.size(), (m_tiles.size() + tiles_per_chunk - 1) / tiles_per_chunk));
+    m_rawTiles = 0;
+}
+
+void CompressedDepth::Expand(const int32_t tile_x, const int32_t tile_y)
+{
+    auto& tile = At(tile_x, tile_y);
+    {
+        std::lock_guard<std::mutex> lock(*m_mutex);
+        tile.raw = static_cast<uint32_t>(m_rawTiles++);
+        auto& chunk = m_chunks[tile.raw / tiles_per_chunk];
+        if (!chunk)
+            chunk.reset(new float_t[tiles_per_chunk * tile_pixels]);
+    }
+
+    auto depth = RawTile(tile.raw);
+    for (int32_t y = 0; y < tile_size; ++y)
+    {
+        for (int32_t x = 0; x < tile_size; ++x)
+        {
+            *depth++ = tile.state == TileState::Clear
+                ? Float32Depth::clear
+                : PlaneDepth(tile.plane, (tile_x << tile_shift) + x, (tile_y << tile_shift) + y);
+        }
+    }
+    tile.state = TileState::Raw;
+}
+
+DepthView<Float32Depth> CompressedDepth::RawView(const int32_t tile_x, const int32_t tile_y)
+{
+    return { RawTile(At(tile_x, tile_y).raw), tile_size, tile_x << tile_shift, tile_y << tile_shift };
+}
+
+float_t CompressedDepth::Get(const int32_t x, const int32_t y) const
+{
+    const auto& tile = m_tiles[static_cast<size_t>(x >> tile_shift) + static_cast<size_t>(y >> tile_shift) * m_tilesX];
+    switch (tile.state)
+    {
+    case TileState::Plane:
+        return PlaneDepth(tile.plane, x, y);
+    case TileState::Raw:
+        return RawTile(tile.raw)[(y & (tile_size - 1)) * tile_size + (x & (tile_size - 1))];
+    default:
+        return Float32Depth::clear;
+    }
+}
+
+size_t CompressedDepth::MemoryBytes() const
+{
+    size_t chunks = 0;
+    for (const auto& chunk : m_chunks)
+    {
+        chunks += chunk != nullptr;
+    }
+    return m_tiles.size() * sizeof(Tile) + chunks * tiles_per_chunk * tile_pixels * sizeof(float_t);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "hizbuffer.hpp"
+#include "img.hpp"
+#include "rasterizer.hpp"
+
+// Float depth kept per 8x8 tile (the HiZ blocks). A tile starts out clear,
+// holds only the plane of the last triangle that covered and passed all of
+// it, and gets full storage once a triangle covers part of it or fails
+// somewhere. Planes are evaluated with the kernels' exact float math, so
+// depth tests come out the same as with Float32.
+class CompressedDepth
+{
+public:
+    static constexpr int32_t tile_shift = HiZBuffer::block_shift;
+    static constexpr int32_t tile_size = 1 << tile_shift;
+
+    enum class TileState : uint8_t
+    {
+        Clear,
+        Plane,
+        Raw
+    };
+
+    // What evaluating depth at a pixel needs from TriangleSetup.
+    struct Plane
+    {
+        std::array<float_t, 3> z;
+        std::array<BarycentricPlane, 3> barycentric;
+        int32_t originX;
+        int32_t originY;
+    };
+
+    struct Tile
+    {
+        TileState state = TileState::Clear;
+        uint32_t raw = 0;
+        Plane plane;
+    };
+
+    static Plane PlaneOf(const TriangleSetup& setup)
+    {
+        return { setup.z, setup.barycentric, setup.originX, setup.originY };
+    }
+
+    static float_t PlaneDepth(const Plane& plane, const int32_t x, const int32_t y)
+    {
+        const auto fx = static_cast<float_t>(x - plane.originX);
+        const auto fy = static_cast<float_t>(y - plane.originY);
+        float_t b[3];
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const auto& weight = plane.barycentric[i];
+            b[i] = (weight.c + fy * weight.dy) + fx * weight.dx;
+        }
+        return plane.z[0] * b[0] + plane.z[1] * b[1] + plane.z[2] * b[2];
+    }
+
+    // Marks every tile clear, keeping the storage of earlier frames.
+    void Reset(const Width width, const Height height);
+
+    Tile& At(const int32_t tile_x, const int32_t tile_y)
+    {
+        return m_tiles[static_cast<size_t>(tile_x) + static_cast<size_t>(tile_y) * m_tilesX];
+    }
+
+    // Gives a clear or plane tile full storage holding the same depth. Safe
+    // to call from several threads as long as each owns its tiles.
+    void Expand(const int32_t tile_x, const int32_t tile_y);
+    DepthView<Float32Depth> RawView(const int32_t tile_x, const int32_t tile_y);
+
+    float_t Get(const int32_t x, const int32_t y) const;
+    size_t MemoryBytes() const;
+
+private:
+    static constexpr size_t tile_pixels = tile_size * tile_size;
+    static constexpr size_t tiles_per_chunk = 64;
+
+    std::vector<Tile> m_tiles;
+    size_t m_tilesX = 0;
+    // Raw tiles come from chunks that stay put while other threads use them.
+    std::vector<std::unique_ptr<float_t[]>> m_chunks;
+    size_t m_rawTiles = 0;
+    // Behind a pointer so framebuffers stay movable.
+    std::unique_ptr<std::mutex> m_mutex = std::make_unique<std::mutex>();
+
+    float_t* RawTile(const uint32_t index) const
+    {
+        return m_chunks[index / tiles_per_chunk].get() + (index % tiles_per_chunk) * tile_pixels;
+    }
+};
@@ -0,0 +1,101 @@
+#include "culling.hpp"
+#include <algorithm>
+
+namespace
+{
+    vec3f SnapToPixels(const vec3f& v)
+    {
+        return vec3f{ static_cast<float>(static_cast<int>(get_x(v))),
+                      static_cast<float>(static_cast<int>(get_y(v))),
+                      get_z(v) };
+    }
+
+    // Keeps the part of polygon where distance(vertex) >= 0.
+    template <typename DistanceFunc>
+    void ClipPolygon(ClippedPolygon& polygon, DistanceFunc&& distance)
+    {
+        ClippedPolygon clipped;
+        for (size_t i = 0; i < polygon.count; ++i)
+        {
+            const auto& from = polygon.vertices[i];
+            const auto& to = polygon.vertices[(i + 1) % polygon.count];
+            const auto d_from = distance(from.position);
+            const auto d_to = distance(to.position);
+
+            if (d_from >= 0.f)
+                clipped.vertices[clipped.count++] = from;
+
+            if ((d_from >= 0.f) != (d_to >= 0.f))
+            {
+                const auto t = d_from / (d_from - d_to);
+                clipped.vertices[clipped.count++] = {
+                    from.position + (to.position - from.position) * t,
+                    from.weights + (to.weights - from.weights) * t };
+            }
+        }
+        polygon = clipped;
+    }
+}
+
+Triangle SnapToPixels(const Triangle& screen)
+{
+    return { SnapToPixels(screen[0]), SnapToPixels(screen[1]), SnapToPixels(screen[2]) };
+}
+
+CullResult CullTriangle(const Triangle& screen, const ClipVolume& volume, Triangle& snapped, ClippedPolygon& polygon)
+{
+    const auto&[a, b, c] = screen;
+
+    // Counter-clockwise on screen faces the viewer.
+    const auto area =
+        (static_cast<double>(get_x(b)) - get_x(a)) * (static_cast<double>(get_y(c)) - get_y(a)) -
+        (static_cast<double>(get_x(c)) - get_x(a)) * (static_cast<double>(get_y(b)) - get_y(a));
+    if (area == 0.)
+        return CullResult::Degenerate;
+    if (volume.cullBackFaces && area < 0.)
+        return CullResult::BackFacing;
+
+    // Snapping truncates, so only positions in (-1, width) can reach a pixel.
+    const auto min_x = std::min({ get_x(a), get_x(b), get_x(c) });
+    const auto max_x = std::max({ get_x(a), get_x(b), get_x(c) });
+    const auto min_y = std::min({ get_y(a), get_y(b), get_y(c) });
+    const auto max_y = std::max({ get_y(a), get_y(b), get_y(c) });
+    const auto min_z = std::min({ get_z(a), get_z(b), get_z(c) });
+    const auto max_z = std::max({ get_z(a), get_z(b), get_z(c) });
+    if (max_x <= -1.f || max_y <= -1.f || min_x >= volume.width || min_y >= volume.height || min_z > volume.nearZ)
+        return CullResult::OffScreen;
+
+    const auto in_guard_band =
+        min_x >= -guard_band && min_y >= -guard_band &&
+        max_x <= volume.width + guard_band && max_y <= volume.height + guard_band;
+    if (in_guard_band && max_z <= volume.nearZ)
+    {
+        snapped = SnapToPixels(screen);
+        const auto&[sa, sb, sc] = snapped;
+        const auto snapped_area =
+            (static_cast<int64_t>(get_x(sb)) - static_cast<int64_t>(get_x(sa))) *
+                (static_cast<int64_t>(get_y(sc)) - static_cast<int64_t>(get_y(sa))) -
+            (static_cast<int64_t>(get_x(sc)) - static_cast<int64_t>(get_x(sa))) *
+                (static_cast<int64_t>(get_y(sb)) - static_cast<int64_t>(get_y(sa)));
+        return snapped_area == 0 ? CullResult::Degenerate : CullResult::Accepted;
+    }
+
+    polygon.count = 3;
+    polygon.vertices[0] = { a, vec3f{ 1.f, 0.f, 0.f } };
+    polygon.vertices[1] = { b, vec3f{ 0.f, 1.f, 0.f } };
+    polygon.vertices[2] = { c, vec3f{ 0.f, 0.f, 1.f } };
+
+    ClipPolygon(polygon, [&volume](const vec3f& p) { return volume.nearZ - get_z(p); });
+    ClipPolygon(polygon, [](const vec3f& p) { return get_x(p) + guard_band; });
+    ClipPolygon(polygon, [&volume](const vec3f& p) { return volume.width + guard_band - get_x(p); });
+    ClipPolygon(polygon, [](const vec3f& p) { return get_y(p) + guard_band; });
+    ClipPolygon(polygon, [&volume](const vec3f& p) { return volume.height + guard_band - get_y(p); });
+    if (polygon.count < 3)
+        return CullResult::OffScreen;
+
+    for (size_t i = 0; i < polygon.count; ++i)
+    {
+        polygon.vertices[i].position = SnapToPixels(polygon.vertices[i].position);
+    }
+    return CullResult::Clipped;
+}
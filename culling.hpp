@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include "rasterizer.hpp"
+
+// Triangles reaching this far past the viewport are clipped, anything
+// closer is left to the rasterizer's clip rectangle. Keeps fixed point
+// edge values and float barycentrics well inside their precision.
+constexpr float_t guard_band = 4096.f;
+
+struct ClipVolume
+{
+    float_t width;
+    float_t height;
+    // Fragments nearer than this (larger z) are clipped away.
+    float_t nearZ;
+    bool cullBackFaces;
+};
+
+// Vertex of a clipped polygon, snapped to pixels, with its weights relative
+// to the corners of the source triangle for interpolating vertex attributes.
+struct ClipVertex
+{
+    vec3f position;
+    vec3f weights;
+};
+
+// Each of the five clip planes adds at most one vertex to the triangle.
+struct ClippedPolygon
+{
+    std::array<ClipVertex, 8> vertices;
+    size_t count = 0;
+};
+
+enum class CullResult
+{
+    Accepted,
+    Clipped,
+    BackFacing,
+    Degenerate,
+    OffScreen
+};
+
+// Rounds unsnapped screen positions down to whole pixels the way vertices
+// have always been placed.
+Triangle SnapToPixels(const Triangle& screen);
+
+// Classifies a triangle given in unsnapped screen coordinates. Accepted
+// triangles are written to snapped; clipped ones leave their visible part
+// in polygon, to be drawn as a fan.
+CullResult CullTriangle(const Triangle& screen, const ClipVolume& volume, Triangle& snapped, ClippedPolygon& polygon);
@@ -0,0 +1,63 @@
+#include "depthbuffer.hpp"
+
+void DepthBuffer::SetFormat(const DepthFormat format)
+{
+    if (format == m_format)
+        return;
+
+    m_format = format;
+    m_width = 0;
+    m_height = 0;
+    std::vector<float_t>().swap(m_float32);
+    std::vector<uint16_t>().swap(m_unorm16);
+    std::vector<uint8_t>().swap(m_unorm24);
+    m_compressed = CompressedDepth{};
+}
+
+void DepthBuffer::Reset(const Width width, const Height height)
+{
+    m_width = width;
+    m_height = height;
+    switch (m_format)
+    {
+    case DepthFormat::Float32:
+        m_float32.assign(width * height, Float32Depth::clear);
+        m_hiZ.Reset(width, height, Float32Depth::clear);
+        break;
+    case DepthFormat::Unorm16:
+        m_unorm16.assign(width * height, Unorm16Depth::clear);
+        m_hiZ.Reset(width, height, Unorm16Depth::clear);
+        break;
+    case DepthFormat::Unorm24:
+        m_unorm24.assign(width * height * Unorm24Depth::elements_per_pixel, 0);
+        m_hiZ.Reset(width, height, Unorm24Depth::clear);
+        break;
+    case DepthFormat::Compressed:
+        m_compressed.Reset(width, height);
+        m_hiZ.Reset(width, height, Float32Depth::clear);
+        break;
+    }
+}
+
+float_t DepthBuffer::Get(const int32_t x, const int32_t y)
+{
+    switch (m_format)
+    {
+    case DepthFormat::Unorm16:
+        return static_cast<float_t>(Unorm16Depth::Load(View<Unorm16Depth>().Pixel(x, y)));
+    case DepthFormat::Unorm24:
+        return static_cast<float_t>(Unorm24Depth::Load(View<Unorm24Depth>().Pixel(x, y)));
+    case DepthFormat::Compressed:
+        return m_compressed.Get(x, y);
+    default:
+        return Float32Depth::Load(View<Float32Depth>().Pixel(x, y));
+    }
+}
+
+size_t DepthBuffer::MemoryBytes() const
+{
+    return m_float32.capacity() * sizeof(float_t)
+        + m_unorm16.capacity() * sizeof(uint16_t)
+        + m_unorm24.capacity()
+        + (m_format == DepthFormat::Compressed ? m_compressed.MemoryBytes() : 0);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <type_traits>
+#include <vector>
+#include "compresseddepth.hpp"
+#include "depthformat.hpp"
+#include "hizbuffer.hpp"
+#include "img.hpp"
+
+// Depth of every pixel in the selected format, with the HiZ blocks built
+// over it.
+class DepthBuffer
+{
+    DepthFormat m_format = DepthFormat::Float32;
+    Width m_width = 0;
+    Height m_height = 0;
+    std::vector<float_t> m_float32;
+    std::vector<uint16_t> m_unorm16;
+    std::vector<uint8_t> m_unorm24;
+    CompressedDepth m_compressed;
+    HiZBuffer m_hiZ;
+
+public:
+    // Frees the storage of the previous format; the buffer needs a Reset
+    // before it's used again.
+    void SetFormat(const DepthFormat format);
+    DepthFormat GetFormat() const { return m_format; }
+    ImageSize GetSize() const { return { m_width, m_height }; }
+
+    // Clears to the farthest depth, keeping the storage when the size doesn't grow.
+    void Reset(const Width width, const Height height);
+
+    HiZBuffer& HiZ() { return m_hiZ; }
+    CompressedDepth& Compressed() { return m_compressed; }
+
+    template <typename Format>
+    DepthView<Format> View()
+    {
+        if constexpr (std::is_same_v<Format, Float32Depth>)
+            return { m_float32.data(), m_width };
+        else if constexpr (std::is_same_v<Format, Unorm16Depth>)
+            return { m_unorm16.data(), m_width };
+        else
+            return { m_unorm24.data(), m_width };
+    }
+
+    // Stored code at a pixel, which for Float32 and Compressed is z itself.
+    float_t Get(const int32_t x, const int32_t y);
+    size_t MemoryBytes() const;
+};
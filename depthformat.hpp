@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+enum class DepthFormat
+{
+    Float32,
+    Unorm16,
+    Unorm24,
+    // Float depth in tiles that hold a single plane equation for as long as
+    // one triangle covers all of them.
+    Compressed
+};
+
+// Formats turn interpolated z into a code that the depth test compares and
+// stores. Like z, larger codes are nearer. Normalized formats map z in
+// [-1, 1], the range models are drawn from, onto [1, max_code] and clamp
+// whatever lies outside; 0 is what a cleared pixel holds.
+struct Float32Depth
+{
+    using Storage = float_t;
+    using Code = float_t;
+    static constexpr size_t elements_per_pixel = 1;
+    static constexpr Code clear = -std::numeric_limits<float_t>::max();
+
+    static Code Encode(const float_t z) { return z; }
+    static Code Load(const Storage* pixel) { return *pixel; }
+    static void Store(Storage* pixel, const Code code) { *pixel = code; }
+};
+
+template <uint32_t Bits>
+struct UnormDepth
+{
+    using Code = uint32_t;
+    static constexpr Code clear = 0;
+    static constexpr float_t max_code = static_cast<float_t>((1u << Bits) - 1);
+    static constexpr float_t half_range = (max_code - 1.f) * .5f;
+
+    // The SIMD kernels encode with the same operations, rounding included.
+    static Code Encode(const float_t z)
+    {
+        return static_cast<Code>(std::lrint(std::min(std::max((z + 1.f) * half_range + 1.f, 1.f), max_code)));
+    }
+};
+
+struct Unorm16Depth : UnormDepth<16>
+{
+    using Storage = uint16_t;
+    static constexpr size_t elements_per_pixel = 1;
+
+    static Code Load(const Storage* pixel) { return *pixel; }
+    static void Store(Storage* pixel, const Code code) { *pixel = static_cast<Storage>(code); }
+};
+
+// Three bytes per pixel, least significant first.
+struct Unorm24Depth : UnormDepth<24>
+{
+    using Storage = uint8_t;
+    static constexpr size_t elements_per_pixel = 3;
+
+    static Code Load(const Storage* pixel)
+    {
+        return Code{ pixel[0] } | (Code{ pixel[1] } << 8) | (Code{ pixel[2] } << 16);
+    }
+
+    static void Store(Storage* pixel, const Code code)
+    {
+        pixel[0] = static_cast<Storage>(code);
+        pixel[1] = static_cast<Storage>(code >> 8);
+        pixel[2] = static_cast<Storage>(code >> 16);
+    }
+};
+
+// Depth storage of a rectangle of the image, possibly a single tile of it;
+// Pixel takes image coordinates.
+template <typename Format>
+struct DepthView
+{
+    typename Format::Storage* data;
+    size_t stride;
+    int32_t originX = 0;
+    int32_t originY = 0;
+
+    typename Format::Storage* Pixel(const int32_t x, const int32_t y) const
+    {
+        return data + (static_cast<size_t>(y - originY) * stride + static_cast<size_t>(x - originX))
+            * Format::elements_per_pixel;
+    }
+};
@@ -0,0 +1,31 @@
+#include "framearena.hpp"
+
+void* FrameArena::do_allocate(const size_t bytes, const size_t alignment)
+{
+    void* free = m_buffer.get() + m_used;
+    auto space = m_capacity - m_used;
+    if (m_buffer && std::align(alignment, bytes, free, space))
+    {
+        m_used = m_capacity - space + bytes;
+        return free;
+    }
+
+    const auto size = bytes + alignment;
+    m_overflow.emplace_back(new std::byte[size]);
+    m_overflowBytes += size;
+    void* block = m_overflow.back().get();
+    space = size;
+    return std::align(alignment, bytes, block, space);
+}
+
+void FrameArena::Reset()
+{
+    if (!m_overflow.empty())
+    {
+        m_capacity += m_overflowBytes;
+        m_buffer.reset(new std::byte[m_capacity]);
+        m_overflow.clear();
+        m_overflowBytes = 0;
+    }
+    m_used = 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for data that lives for a single render: transformed
+// vertices, screen triangles, tile bins. Deallocation does nothing and Reset
+// releases everything at once. A render that outgrows the buffer spills into
+// extra blocks; the next Reset swaps them all for one buffer big enough to
+// hold that render, so repeating the same work stops allocating.
+// Not thread-safe.
+class FrameArena : public std::pmr::memory_resource
+{
+    std::unique_ptr<std::byte[]> m_buffer;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+    std::vector<std::unique_ptr<std::byte[]>> m_overflow;
+    size_t m_overflowBytes = 0;
+
+    virtual void* do_allocate(const size_t bytes, const size_t alignment) override;
+    virtual void do_deallocate(void*, size_t, size_t) override {}
+    virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+    template <typename T>
+    using Vector = std::pmr::vector<T>;
+
+    // Resets the arena on entry and again on exit, so whatever a render
+    // spilled is folded into the buffer before the next one starts. Declare
+    // it before anything allocated from the arena.
+    class Scope
+    {
+        FrameArena& m_arena;
+    public:
+        explicit Scope(FrameArena& arena) : m_arena(arena) { m_arena.Reset(); }
+        ~Scope() { m_arena.Reset(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    void Reset();
+    size_t Capacity() const { return m_capacity; }
+};
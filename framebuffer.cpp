@@ -0,0 +1,80 @@
+#include "framebuffer.hpp"
+#include "tgacodec.hpp"
+#include "tgaimpl.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+void FrameBuffer::Resize(const Width width, const Height height, const size_t bytes_per_pixel)
+{
+    m_width = width;
+    m_height = height;
+    m_bytesPerPixel = bytes_per_pixel;
+    m_color.resize(width * height * bytes_per_pixel);
+}
+
+void FrameBuffer::CreateImage(const Width width, const Height height)
+{
+    Resize(width, height, 3);
+    Clear();
+}
+
+void FrameBuffer::ReadImage(const std::filesystem::path& path_to_img)
+{
+    if (path_to_img.extension() != ".tga")
+        throw std::runtime_error("Invalid file provided");
+
+    const TgaDecoder decoder(path_to_img);
+    const auto& info = decoder.Info();
+    Resize(info.width, info.height, info.bytesPerPixel);
+    ClearDepth();
+    decoder.Decode(GetPixels());
+}
+
+void FrameBuffer::WriteImage(const std::filesystem::path& path_to_write)
+{
+    WriteTga(std::as_const(*this).GetPixels(), path_to_write);
+}
+
+std::unique_ptr<IColor> FrameBuffer::GetPixelColor(const int32_t x, const int32_t y) const
+{
+    // TgaColor takes its channels in stored (B, G, R) order.
+    const auto rgba = GetPixels().Get(x, y);
+    return std::make_unique<TgaColor>(rgba.b, rgba.g, rgba.r, rgba.a);
+}
+
+void FrameBuffer::SetPixelColor(const int32_t x, const int32_t y, const float_t intensity, const IColor& color)
+{
+    GetPixels().Set(x, y, intensity, color.ToRgba());
+}
+
+void FrameBuffer::Clear(const RGBA& color)
+{
+    ClearColor(color);
+    ClearDepth();
+}
+
+void FrameBuffer::ClearColor(const RGBA& color)
+{
+    if (m_color.empty())
+        return;
+
+    const uint8_t bgra[4] = { color.b, color.g, color.r, color.a };
+    if (std::all_of(bgra, bgra + m_bytesPerPixel, [&bgra](const uint8_t c) { return c == bgra[0]; }))
+    {
+        std::memset(m_color.data(), bgra[0], m_color.size());
+        return;
+    }
+
+    // Only the first row is built pixel by pixel, the others copy it.
+    const auto row_bytes = m_width * m_bytesPerPixel;
+    for (size_t i = 0; i < row_bytes; ++i)
+    {
+        m_color[i] = bgra[i % m_bytesPerPixel];
+    }
+    for (size_t y = 1; y < m_height; ++y)
+    {
+        std::memcpy(m_color.data() + y * row_bytes, m_color.data(), row_bytes);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include "depthbuffer.hpp"
+#include "img.hpp"
+
+// Render target owning colour and depth storage, meant to be kept around and
+// rendered into frame after frame. Unlike a plain IImg, depth survives
+// between renders until the next Clear, so several models can share a frame.
+class FrameBuffer : public IImg
+{
+    std::vector<uint8_t> m_color;
+    DepthBuffer m_depth;
+    Width m_width = 0;
+    Height m_height = 0;
+    size_t m_bytesPerPixel = 3;
+
+    void Resize(const Width width, const Height height, const size_t bytes_per_pixel);
+
+public:
+    // Resizes without reallocating when the frame doesn't grow, then clears.
+    virtual void CreateImage(const Width width, const Height height) override;
+    virtual void ReadImage(const std::filesystem::path& path_to_img) override;
+    virtual void WriteImage(const std::filesystem::path& path_to_write) override;
+    virtual ImageSize GetImageSize() const override { return { m_width, m_height }; }
+    virtual std::unique_ptr<IColor> GetPixelColor(const int32_t x, const int32_t y) const override;
+    virtual void SetPixelColor(const int32_t x, const int32_t y, const float_t intensity, const IColor& color) override;
+    virtual PixelView GetPixels() override { return { m_color.data(), m_width, m_height, m_bytesPerPixel }; }
+    virtual ConstPixelView GetPixels() const override { return { m_color.data(), m_width, m_height, m_bytesPerPixel }; }
+
+    void Clear(const RGBA& color = RGBA{ 0, 0, 0, 0 });
+    void ClearColor(const RGBA& color);
+    void ClearDepth() { m_depth.Reset(m_width, m_height); }
+    void SetDepthFormat(const DepthFormat format)
+    {
+        m_depth.SetFormat(format);
+        ClearDepth();
+    }
+    DepthBuffer& Depth() { return m_depth; }
+    const DepthBuffer& Depth() const { return m_depth; }
+};
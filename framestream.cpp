@@ -0,0 +1,116 @@
+#include "framestream.hpp"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+OutputFormat ParseOutputFormat(const std::string& name)
+{
+    if (name == "tga")
+        return OutputFormat::Tga;
+    if (name == "ppm")
+        return OutputFormat::Ppm;
+    if (name == "rgb")
+        return OutputFormat::Rgb;
+    if (name == "rgba")
+        return OutputFormat::Rgba;
+
+    throw std::runtime_error("Unknown output format " + name);
+}
+
+FrameStream::FrameStream(const OutputFormat format)
+    : m_file(stdout)
+    , m_ownsFile(false)
+    , m_format(format)
+{
+    if (format == OutputFormat::Tga)
+        throw std::runtime_error("TGA frames can't be streamed");
+
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+FrameStream::FrameStream(const std::filesystem::path& path, const OutputFormat format)
+    : m_file(nullptr)
+    , m_ownsFile(true)
+    , m_format(format)
+{
+    if (format == OutputFormat::Tga)
+        throw std::runtime_error("TGA frames can't be streamed");
+
+    m_file = std::fopen(path.string().c_str(), "wb");
+    if (!m_file)
+        throw std::runtime_error("Couldn't open " + path.string() + " for writing");
+}
+
+FrameStream::~FrameStream()
+{
+    if (m_ownsFile)
+        std::fclose(m_file);
+    else
+        std::fflush(m_file);
+}
+
+void FrameStream::Write(const ConstPixelView& pixels)
+{
+    BeginFrame(pixels.width, pixels.height);
+    WriteBand(pixels);
+}
+
+void FrameStream::BeginFrame(const Width width, const Height height)
+{
+    if (m_rowsLeft != 0)
+        throw std::runtime_error("Previous frame isn't finished");
+
+    m_frameWidth = width;
+    m_rowsLeft = height;
+    if (m_format == OutputFormat::Ppm)
+    {
+        const auto header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        if (std::fwrite(header.data(), 1, header.size(), m_file) != header.size())
+            throw std::runtime_error("Couldn't write frame");
+    }
+}
+
+void FrameStream::WriteBand(const ConstPixelView& pixels)
+{
+    if (pixels.width != m_frameWidth || pixels.height > m_rowsLeft)
+        throw std::runtime_error("Band doesn't fit the frame");
+
+    const auto channels = m_format == OutputFormat::Rgba ? 4u : 3u;
+    const auto write = [this](const void* data, const size_t size) {
+        if (std::fwrite(data, 1, size, m_file) != size)
+            throw std::runtime_error("Couldn't write frame");
+    };
+
+    m_row.resize(pixels.width * channels);
+    for (auto y = pixels.height; y-- > 0;)
+    {
+        const auto source = pixels.data + y * pixels.width * pixels.bytesPerPixel;
+        auto target = m_row.data();
+        for (size_t x = 0; x < pixels.width; ++x, target += channels)
+        {
+            const auto pixel = source + x * pixels.bytesPerPixel;
+            if (pixels.bytesPerPixel == 1)
+            {
+                target[0] = target[1] = target[2] = pixel[0];
+            }
+            else
+            {
+                target[0] = pixel[2];
+                target[1] = pixel[1];
+                target[2] = pixel[0];
+            }
+            if (channels == 4)
+                target[3] = pixels.bytesPerPixel == 4 ? pixel[3] : 255;
+        }
+        write(m_row.data(), m_row.size());
+    }
+
+    m_rowsLeft -= pixels.height;
+    if (m_rowsLeft == 0 && std::fflush(m_file) != 0)
+        throw std::runtime_error("Couldn't write frame");
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "img.hpp"
+
+enum class OutputFormat
+{
+    Tga,
+    Ppm,
+    Rgb,
+    Rgba
+};
+
+OutputFormat ParseOutputFormat(const std::string& name);
+
+// Streams frames back to back into stdout or any writable path such as a
+// named pipe, for consumers reading raw video or concatenated PPMs. Rows
+// go out top of the picture first, converted one row at a time straight
+// from the framebuffer.
+class FrameStream
+{
+    std::FILE* m_file;
+    bool m_ownsFile;
+    OutputFormat m_format;
+    std::vector<uint8_t> m_row;
+    Width m_frameWidth = 0;
+    Height m_rowsLeft = 0;
+
+public:
+    // Streams to stdout.
+    explicit FrameStream(const OutputFormat format);
+    FrameStream(const std::filesystem::path& path, const OutputFormat format);
+    FrameStream(const FrameStream&) = delete;
+    FrameStream& operator=(const FrameStream&) = delete;
+    ~FrameStream();
+
+    void Write(const ConstPixelView& pixels);
+    // Frames too large to hold at once go out in bands: BeginFrame writes
+    // the header, then WriteBand takes bands of the same width, top of the
+    // picture first, until every row is written.
+    void BeginFrame(const Width width, const Height height);
+    void WriteBand(const ConstPixelView& pixels);
+};
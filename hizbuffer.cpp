@@ -0,0 +1,8 @@
+#include "hizbuffer.hpp"
+
+void HiZBuffer::Reset(const Width width, const Height height, const float_t depth)
+{
+    m_blocksX = (width + block_size - 1) >> block_shift;
+    m_blocksY = (height + block_size - 1) >> block_shift;
+    m_minDepth.assign(m_blocksX * m_blocksY, depth);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "img.hpp"
+#include "rasterizer.hpp"
+
+// Farthest depth stored in every 8x8 block of the z-buffer. A fragment
+// passes when the stored depth is smaller than its own, so a triangle whose
+// depth never exceeds a block's minimum can't change any pixel in it.
+// Stale (smaller) values only cost rejections, never correctness.
+class HiZBuffer
+{
+    std::vector<float_t> m_minDepth;
+    size_t m_blocksX = 0;
+    size_t m_blocksY = 0;
+
+public:
+    static constexpr int32_t block_shift = 3;
+    static constexpr int32_t block_size = 1 << block_shift;
+
+    void Reset(const Width width, const Height height, const float_t depth);
+    bool IsOccluded(const int32_t block_x, const int32_t block_y, const float_t max_depth) const
+    {
+        return m_minDepth[static_cast<size_t>(block_x) + static_cast<size_t>(block_y) * m_blocksX] >= max_depth;
+    }
+
+    void Set(const int32_t block_x, const int32_t block_y, const float_t min_depth)
+    {
+        m_minDepth[static_cast<size_t>(block_x) + static_cast<size_t>(block_y) * m_blocksX] = min_depth;
+    }
+
+    // Recomputes the blocks overlapping region from the full resolution
+    // buffer. Blocks hold depth codes, exact as floats for every format.
+    template <typename Format>
+    void Update(const DepthView<Format>& depth, const Width width, const Height height, const PixelRegion& region)
+    {
+        for (auto by = region.minY >> block_shift; by <= region.maxY >> block_shift; ++by)
+        {
+            const auto y_begin = by << block_shift;
+            const auto y_end = static_cast<int32_t>(std::min(static_cast<size_t>(by + 1) << block_shift, height));
+            for (auto bx = region.minX >> block_shift; bx <= region.maxX >> block_shift; ++bx)
+            {
+                const auto x_begin = bx << block_shift;
+                const auto x_end = static_cast<int32_t>(std::min(static_cast<size_t>(x_begin + block_size), width));
+
+                auto min_depth = static_cast<float_t>(Format::Load(depth.Pixel(x_begin, y_begin)));
+                for (auto y = y_begin; y < y_end; ++y)
+                {
+                    auto pixel = depth.Pixel(x_begin, y);
+                    for (auto x = x_begin; x < x_end; ++x, pixel += Format::elements_per_pixel)
+                    {
+                        min_depth = std::min(min_depth, static_cast<float_t>(Format::Load(pixel)));
+                    }
+                }
+                Set(bx, by, min_depth);
+            }
+        }
+    }
+};
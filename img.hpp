@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
 #include <memory>
 #include <tuple>
 #include <filesystem>
@@ -16,6 +18,66 @@ struct RGBA
     uint8_t a;
 };
 
+// Non-owning view of an image's pixel buffer for hot loops, with no
+// allocation or virtual call per pixel. Pixels are stored in TGA byte
+// order (B, G, R, A) with 1, 3 or 4 bytes per pixel; Get and Set behave
+// exactly like IImg::GetPixelColor and IImg::SetPixelColor.
+template <typename Byte>
+struct BasicPixelView
+{
+    Byte* data;
+    Width width;
+    Height height;
+    size_t bytesPerPixel;
+
+    bool Contains(const int32_t x, const int32_t y) const
+    {
+        return data != nullptr && x >= 0 && y >= 0
+            && static_cast<Width>(x) < width && static_cast<Height>(y) < height;
+    }
+
+    Byte* Pixel(const int32_t x, const int32_t y) const
+    {
+        return data + (static_cast<size_t>(x) + static_cast<size_t>(y) * width) * bytesPerPixel;
+    }
+
+    RGBA Get(const int32_t x, const int32_t y) const
+    {
+        uint8_t bgra[4] = { 0, 0, 0, 0 };
+        if (Contains(x, y))
+        {
+            const auto pixel = Pixel(x, y);
+            for (size_t i = 0; i < bytesPerPixel; ++i)
+            {
+                bgra[i] = pixel[i];
+            }
+        }
+        return { bgra[2], bgra[1], bgra[0], bgra[3] };
+    }
+
+    void Set(const int32_t x, const int32_t y, float_t intensity, const RGBA& color) const
+    {
+        if (!Contains(x, y))
+            return;
+
+        intensity = intensity > 1.f ? 1.f : (intensity < 0.f ? 0.f : intensity);
+        const uint8_t bgra[4] = {
+            static_cast<uint8_t>(color.b * intensity),
+            static_cast<uint8_t>(color.g * intensity),
+            static_cast<uint8_t>(color.r * intensity),
+            static_cast<uint8_t>(color.a * intensity) };
+
+        const auto pixel = Pixel(x, y);
+        for (size_t i = 0; i < bytesPerPixel; ++i)
+        {
+            pixel[i] = bgra[i];
+        }
+    }
+};
+
+using PixelView = BasicPixelView<uint8_t>;
+using ConstPixelView = BasicPixelView<const uint8_t>;
+
 struct IColor
 {
     virtual RGBA ToRgba() const = 0;
@@ -30,5 +92,7 @@ struct IImg
     virtual ImageSize GetImageSize() const = 0;
     virtual std::unique_ptr<IColor> GetPixelColor(const int32_t x, const int32_t y) const = 0;
     virtual void SetPixelColor(const int32_t x, const int32_t y, const float_t intensity, const IColor& color) = 0;
+    virtual PixelView GetPixels() = 0;
+    virtual ConstPixelView GetPixels() const = 0;
     virtual ~IImg() = default;
 };
@@ -315,6 +315,10 @@ unsigned char *TGAImage::buffer() {
     return data;
 }
 
+const unsigned char *TGAImage::buffer() const {
+    return data;
+}
+
 void TGAImage::clear() {
     memset((void *)data, 0, width*height*bytespp);
 }
@@ -93,6 +93,7 @@ public:
     int get_height() const;
     int get_bytespp() const;
     unsigned char *buffer();
+    const unsigned char *buffer() const;
     void clear();
 };
 
@@ -1,14 +1,23 @@
 #include "renderer.hpp"
 #include "img.hpp"
-#include "tgaimpl.hpp"
+#include "framebuffer.hpp"
+#include "tgacodec.hpp"
 #include "model.hpp"
 #include "objimpl.hpp"
+#include "binarymesh.hpp"
+#include "meshlod.hpp"
+#include "meshorder.hpp"
+#include "batch.hpp"
+#include "sequence.hpp"
+#include "framestream.hpp"
+#include "renderstats.hpp"
 #include "hola/hola.hpp"
 #include "Clara/include/clara.hpp"
 
+#include <exception>
 #include <iostream>
+#include <utility>
 
-using ImgPtr = std::unique_ptr<IImg>;
 using ColorPtr = std::unique_ptr<IColor>;
 using ModelPtr = std::unique_ptr<IModel>;
 
@@ -18,8 +27,31 @@ struct Config
     std::string output_filename;
     std::string texture_filename;
     std::string model_filename;
-    uint32_t width;
-    uint32_t height;
+    std::string bake_filename;
+    std::string batch_filename;
+    std::string sweep = "light";
+    std::string format = "tga";
+    std::string shading = "flat";
+    std::string normal_map_filename;
+    std::string stats_filename;
+    std::string depth_format = "float";
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t threads = 1;
+    uint32_t jobs = 1;
+    uint32_t frames = 0;
+    uint32_t queue_depth = 2;
+    uint32_t band_height = 0;
+    uint32_t samples = 1;
+    float lod = 0.f;
+    bool tinyobj = false;
+    bool reorder = false;
+    bool verify_cache = false;
+    bool mipmap = false;
+    bool bilinear = false;
+    bool deferred = false;
+    bool to_stdout = false;
+    bool stats = false;
 };
 
 Config ParseCmdline(int argc, const char* argv[])
@@ -27,21 +59,90 @@ Config ParseCmdline(int argc, const char* argv[])
     using namespace clara;
 
     Config config;
-    auto cli =  Opt(config.output_filename, "output file").required()
+    auto cli =  Opt(config.output_filename, "output file")
                     ["-o"]
                     ("Path to output file") |
-                Opt(config.texture_filename, "texture file").required()
+                Opt(config.format, "tga|ppm|rgb|rgba")
+                    ["--format"]
+                    ("Output format; ppm, rgb and rgba stream every frame into the output") |
+                Opt(config.to_stdout)
+                    ["--stdout"]
+                    ("Stream ppm, rgb or rgba output to stdout instead of -o") |
+                Opt(config.texture_filename, "texture file")
                     ["-t"]
                     ("Path to texture file") |
-                Opt(config.model_filename, "model file").required()
+                Opt(config.model_filename, "model file")
                     ["-m"]
                     ("Path to model file") |
-                Opt(config.width, "width").required()
+                Opt(config.width, "width")
                     ["-w"]
                     ("Width of output file") |
-                Opt(config.height, "height").required()
+                Opt(config.height, "height")
                     ["-h"]
                     ("Height of output file") |
+                Opt(config.threads, "threads")
+                    ["-j"]["--threads"]
+                    ("Number of rendering threads, 0 uses all hardware threads") |
+                Opt(config.tinyobj)
+                    ["--tinyobj"]
+                    ("Load model with tinyobjloader instead of the native parser") |
+                Opt(config.reorder)
+                    ["--reorder"]
+                    ("Reorder triangles of .obj models at load for vertex reuse and spatial locality; --bake stores the order") |
+                Opt(config.mipmap)
+                    ["--mipmap"]
+                    ("Sample texture from a mip chain chosen per triangle") |
+                Opt(config.bilinear)
+                    ["--bilinear"]
+                    ("Use bilinear texture filtering") |
+                Opt(config.shading, "flat|gouraud|normal|depth")
+                    ["--shading"]
+                    ("Shading model; gouraud uses the model's vertex normals, normal needs --normal-map") |
+                Opt(config.normal_map_filename, "normal map")
+                    ["--normal-map"]
+                    ("Path to object space normal map texture") |
+                Opt(config.deferred)
+                    ["--deferred"]
+                    ("Resolve visibility first and shade every pixel once") |
+                Opt(config.samples, "1|4|8")
+                    ["--msaa"]
+                    ("Samples per pixel for anti-aliased edges, each pixel still shaded once") |
+                Opt(config.lod, "pixels")
+                    ["--lod"]
+                    ("Render a simplified level of the model erring by at most this many pixels; levels are built at load unless the .bmesh has them, and --bake stores them") |
+                Opt(config.depth_format, "float|16|24|compressed")
+                    ["--depth-format"]
+                    ("Depth buffer format; 16 and 24 bit depth may resolve near ties differently") |
+                Opt(config.bake_filename, "mesh cache")
+                    ["--bake"]
+                    ("Write model to binary mesh cache (.bmesh) and exit") |
+                Opt(config.batch_filename, "manifest")
+                    ["--batch"]
+                    ("Render every job listed in manifest, one per line: model texture width height lx ly lz output; quote paths with spaces") |
+                Opt(config.jobs, "jobs")
+                    ["--jobs"]
+                    ("Number of batch jobs rendered concurrently") |
+                Opt(config.frames, "frames")
+                    ["--sequence"]
+                    ("Render a sequence of frames, written as <output>_NNNN.tga or streamed") |
+                Opt(config.sweep, "light|rotation")
+                    ["--sweep"]
+                    ("Turn the light or the model around the y axis over the sequence") |
+                Opt(config.queue_depth, "frames")
+                    ["--queue"]
+                    ("Finished sequence frames that may wait for writing") |
+                Opt(config.band_height, "rows")
+                    ["--band"]
+                    ("Render and write the image in bands of this many rows, for pictures too large to hold") |
+                Opt(config.stats)
+                    ["--stats"]
+                    ("Print stage timings and render counters to stderr") |
+                Opt(config.stats_filename, "json file")
+                    ["--stats-json"]
+                    ("Write stage timings and render counters as JSON") |
+                Opt(config.verify_cache)
+                    ["--verify-cache"]
+                    ("Verify the payload checksum of .bmesh models; index ranges are always checked") |
                 Opt(config.help)
                     ["-?"]["--help"]
                     ("Displays help");
@@ -59,27 +160,260 @@ Config ParseCmdline(int argc, const char* argv[])
         std::exit(-1);
     }
 
+    if (!config.batch_filename.empty())
+        return config;
+
+    if (config.model_filename.empty())
+    {
+        std::cerr << "Error in command line: -m is required" << std::endl;
+        std::exit(-1);
+    }
+
+    const auto render_options_missing = (config.output_filename.empty() && !config.to_stdout) ||
+        config.texture_filename.empty() || config.width == 0 || config.height == 0;
+    if (config.bake_filename.empty() && render_options_missing)
+    {
+        std::cerr << "Error in command line: -o, -t, -w and -h are required for rendering" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.format != "tga" && config.format != "ppm" && config.format != "rgb" && config.format != "rgba")
+    {
+        std::cerr << "Error in command line: --format must be tga, ppm, rgb or rgba" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.format == "tga" && config.to_stdout)
+    {
+        std::cerr << "Error in command line: --stdout needs --format ppm, rgb or rgba" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.band_height > 0 && (config.format == "tga" || config.frames > 0))
+    {
+        std::cerr << "Error in command line: --band needs --format ppm, rgb or rgba and no --sequence" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.shading != "flat" && config.shading != "gouraud" && config.shading != "normal" && config.shading != "depth")
+    {
+        std::cerr << "Error in command line: --shading must be flat, gouraud, normal or depth" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.shading == "normal" && config.normal_map_filename.empty())
+    {
+        std::cerr << "Error in command line: --shading normal needs --normal-map" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.samples != 1 && config.samples != 4 && config.samples != 8)
+    {
+        std::cerr << "Error in command line: --msaa must be 1, 4 or 8" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.lod < 0.f)
+    {
+        std::cerr << "Error in command line: --lod must not be negative" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.depth_format != "float" && config.depth_format != "16" && config.depth_format != "24"
+        && config.depth_format != "compressed")
+    {
+        std::cerr << "Error in command line: --depth-format must be float, 16, 24 or compressed" << std::endl;
+        std::exit(-1);
+    }
+
+    if (config.sweep != "light" && config.sweep != "rotation")
+    {
+        std::cerr << "Error in command line: --sweep must be light or rotation" << std::endl;
+        std::exit(-1);
+    }
+
     return config;
 }
 
+ModelPtr LoadModel(const Config& config, const std::string& model_filename)
+{
+    ModelPtr model;
+    const auto cached = std::filesystem::path(model_filename).extension() == ".bmesh";
+    if (cached)
+        model = std::make_unique<BinaryModel>(config.verify_cache);
+    else if (config.tinyobj)
+        model = std::make_unique<Obj>();
+    else
+        model = std::make_unique<MappedObj>(config.threads);
+
+    // Mesh caches keep the order they were baked in.
+    if (config.reorder && !cached)
+        model = std::make_unique<ReorderedModel>(std::move(model));
+    if (config.lod > 0.f)
+        model = std::make_unique<LodModel>(std::move(model));
+
+    model->ReadModel(model_filename);
+    return model;
+}
+
+std::unique_ptr<Texture> LoadTexture(const Config& config, const std::string& texture_filename)
+{
+    const TgaDecoder decoder(texture_filename);
+    const auto& info = decoder.Info();
+    std::vector<uint8_t> texels(info.width * info.height * 4);
+    decoder.Decode(PixelView{ texels.data(), info.width, info.height, 4 });
+
+    return std::make_unique<Texture>(ConstPixelView{ texels.data(), info.width, info.height, 4 }, config.mipmap,
+        config.bilinear ? TextureFilter::Bilinear : TextureFilter::Nearest);
+}
+
+Shading ParseShading(const std::string& name)
+{
+    if (name == "gouraud")
+        return Shading::Gouraud;
+    if (name == "normal")
+        return Shading::NormalMapped;
+    if (name == "depth")
+        return Shading::DepthOnly;
+    return Shading::Flat;
+}
+
+DepthFormat ParseDepthFormat(const std::string& name)
+{
+    if (name == "16")
+        return DepthFormat::Unorm16;
+    if (name == "24")
+        return DepthFormat::Unorm24;
+    if (name == "compressed")
+        return DepthFormat::Compressed;
+    return DepthFormat::Float32;
+}
+
+int RenderBatch(const Config& config)
+{
+    const auto jobs = ReadManifest(config.batch_filename);
+    AssetCache cache(
+        [&config](const std::string& path) { return LoadModel(config, path); },
+        [&config](const std::string& path) { return LoadTexture(config, path); });
+
+    BatchOptions options;
+    options.concurrentJobs = config.jobs;
+    options.threadsPerJob = config.threads;
+    options.deferred = config.deferred;
+    options.depthFormat = ParseDepthFormat(config.depth_format);
+    options.samples = config.samples;
+    options.lodError = config.lod;
+
+    const auto failed = RunBatch(jobs, cache, options, std::cerr);
+    return failed == 0 ? 0 : -1;
+}
+
 int main(int argc, const char* argv[])
 {
-    Config config = ParseCmdline(argc, argv);
+    try
+    {
+        Config config = ParseCmdline(argc, argv);
+
+        if (!config.batch_filename.empty())
+            return RenderBatch(config);
+
+        if (!config.bake_filename.empty())
+        {
+            const auto model = LoadModel(config, config.model_filename);
+            WriteBinaryMesh(model->GetMesh(), config.bake_filename, model->GetLevels());
+            return 0;
+        }
+
+        StageTimer timer;
+        std::unique_ptr<Texture> texture;
+        ModelPtr model;
+        timer.Time("model load", [&] { model = LoadModel(config, config.model_filename); });
+        timer.Time("texture load", [&] { texture = LoadTexture(config, config.texture_filename); });
+        std::shared_ptr<const Texture> normal_map;
+        if (!config.normal_map_filename.empty())
+            timer.Time("normal map load", [&] { normal_map = LoadTexture(config, config.normal_map_filename); });
+
+        Renderer renderer;
+        renderer.SetLightVector({ 0,0,-1 });
+        renderer.SetThreadCount(config.threads);
+        renderer.SetDeferredShading(config.deferred);
+        renderer.SetSampleCount(config.samples);
+        renderer.SetLevelOfDetail(config.lod);
+        renderer.SetShading(ParseShading(config.shading));
+        renderer.SetNormalMap(normal_map);
+        const auto collect_stats = config.stats || !config.stats_filename.empty();
+        renderer.SetStatsEnabled(collect_stats);
 
-    ImgPtr out_image = std::make_unique<TgaImage>();
-    out_image->CreateImage(config.width, config.height);
+        const auto report_stats = [&] {
+            if (config.stats)
+                PrintStats(std::cerr, renderer.GetStats(), timer);
+            if (!config.stats_filename.empty())
+                WriteStatsJson(config.stats_filename, renderer.GetStats(), timer);
+        };
 
-    ImgPtr texture = std::make_unique<TgaImage>();
-    texture->ReadImage(config.texture_filename);
+        const auto format = ParseOutputFormat(config.format);
+        std::unique_ptr<FrameStream> stream;
+        if (config.to_stdout)
+            stream = std::make_unique<FrameStream>(format);
+        else if (format != OutputFormat::Tga)
+            stream = std::make_unique<FrameStream>(config.output_filename, format);
 
-    ModelPtr model = std::make_unique<Obj>();
-    model->ReadModel(config.model_filename);
+        if (config.frames > 0)
+        {
+            SequenceOptions options;
+            options.frameCount = config.frames;
+            options.sweep = config.sweep == "rotation" ? SequenceSweep::Rotation : SequenceSweep::Light;
+            options.width = config.width;
+            options.height = config.height;
+            options.queueDepth = config.queue_depth;
+            options.depthFormat = ParseDepthFormat(config.depth_format);
+            // Frames are written while the next ones render, so both overlap in
+            // one stage.
+            timer.Time("render and write", [&] {
+                RenderSequence(*model, *texture, renderer, options, [&](const ConstPixelView& pixels, const uint32_t frame) {
+                    if (stream)
+                        stream->Write(pixels);
+                    else
+                        WriteTga(pixels, FrameFilename(config.output_filename, frame));
+                });
+            });
+            report_stats();
+            return 0;
+        }
 
-    Renderer renderer;
-    renderer.SetLightVector({ 0,0,-1 });
-    renderer.RenderModel(*model, *texture, *out_image);
+        if (config.band_height > 0)
+        {
+            FrameBuffer band;
+            band.SetDepthFormat(ParseDepthFormat(config.depth_format));
+            // Bands are written as soon as they are rendered, so both overlap in
+            // one stage.
+            timer.Time("render and write", [&] {
+                stream->BeginFrame(config.width, config.height);
+                renderer.RenderModelInBands(*model, *texture, ImageSize{ config.width, config.height }, config.band_height,
+                    band, [&stream](const ConstPixelView& pixels) { stream->WriteBand(pixels); });
+            });
+            report_stats();
+            return 0;
+        }
 
-    out_image->WriteImage(config.output_filename);
+        FrameBuffer out_image;
+        out_image.SetDepthFormat(ParseDepthFormat(config.depth_format));
+        out_image.CreateImage(config.width, config.height);
+        timer.Time("render", [&] { renderer.RenderModel(*model, *texture, out_image); });
 
-    return 0;
+        timer.Time("write", [&] {
+            if (stream)
+                stream->Write(std::as_const(out_image).GetPixels());
+            else
+                out_image.WriteImage(config.output_filename);
+        });
+
+        report_stats();
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
 }
@@ -0,0 +1,98 @@
+#include "mappedfile.hpp"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    const auto error = [&path](const char* reason) {
+        return std::runtime_error("Couldn't map file " + path.string() + ": " + reason);
+    };
+
+#ifdef _WIN32
+    m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        m_file = nullptr;
+        throw error("cannot open");
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        Unmap();
+        throw error("cannot read size");
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0)
+        return;
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data)
+    {
+        Unmap();
+        throw error("mapping failed");
+    }
+#else
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw error("cannot open");
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw error("cannot read size");
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    const auto data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        throw error("mapping failed");
+
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(data);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Unmap();
+}
+
+void MappedFile::Unmap()
+{
+#ifdef _WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    if (m_data)
+        munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+
+    void Unmap();
+
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+};
@@ -0,0 +1,484 @@
+#include "meshlod.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace
+{
+    // Sum of squared distances to a set of planes, as the upper half of a
+    // symmetric 4x4 matrix.
+    struct Quadric
+    {
+        std::array<double, 10> m{};
+
+        static Quadric Plane(const vec3f& normal, const vec3f& point, const double weight)
+        {
+            const double a = get_x(normal);
+            const double b = get_y(normal);
+            const double c = get_z(normal);
+            const double d = -(a * get_x(point) + b * get_y(point) + c * get_z(point));
+            Quadric q;
+            q.m = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+            for (auto& value : q.m)
+            {
+                value *= weight;
+            }
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& other)
+        {
+            for (size_t i = 0; i < m.size(); ++i)
+            {
+                m[i] += other.m[i];
+            }
+            return *this;
+        }
+
+        double Error(const vec3f& p) const
+        {
+            const double x = get_x(p);
+            const double y = get_y(p);
+            const double z = get_z(p);
+            return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+                + m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+                + m[7] * z * z + 2 * m[8] * z
+                + m[9];
+        }
+    };
+
+    Quadric operator+(Quadric lhs, const Quadric& rhs)
+    {
+        lhs += rhs;
+        return lhs;
+    }
+
+    // Moving vertex from onto vertex to; stamps tell whether either changed
+    // since the cost was worked out.
+    struct Collapse
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t fromStamp;
+        uint32_t toStamp;
+
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    // Open borders are held by planes through them at right angles to their
+    // triangle, weighing far more than the surface's own.
+    constexpr double border_weight = 100.;
+    // Collapses turning a triangle's normal further than this cosine are refused.
+    constexpr double min_normal_cos = .25;
+    constexpr uint32_t no_vertex = std::numeric_limits<uint32_t>::max();
+
+    vec3f Normal(const vec3f& v0, const vec3f& v1, const vec3f& v2)
+    {
+        return cross(v1 - v0, v2 - v0);
+    }
+
+    class Simplifier
+    {
+        const MeshView& m_mesh;
+        std::vector<uint32_t> m_corners;
+        std::vector<uint32_t> m_textureCorners;
+        std::vector<uint32_t> m_normalCorners;
+        std::vector<bool> m_alive;
+        std::vector<bool> m_removed;
+        // Vertices whose corners disagree on texture coordinates or normals
+        // stay where they are.
+        std::vector<bool> m_seam;
+        std::vector<uint32_t> m_stamps;
+        std::vector<Quadric> m_quadrics;
+        std::vector<std::vector<uint32_t>> m_vertexTriangles;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_queue;
+        std::vector<uint32_t> m_fromNeighbours;
+        std::vector<uint32_t> m_toNeighbours;
+        size_t m_live = 0;
+        double m_maxCost = 0.;
+
+        bool Contains(const size_t triangle, const uint32_t vertex) const
+        {
+            const auto first = triangle * 3;
+            return m_corners[first] == vertex || m_corners[first + 1] == vertex || m_corners[first + 2] == vertex;
+        }
+
+        vec3f TriangleNormal(const size_t triangle) const
+        {
+            const auto first = triangle * 3;
+            return Normal(m_mesh.positions[m_corners[first]], m_mesh.positions[m_corners[first + 1]],
+                m_mesh.positions[m_corners[first + 2]]);
+        }
+
+        void Neighbours(const uint32_t vertex, std::vector<uint32_t>& neighbours) const
+        {
+            neighbours.clear();
+            for (const auto triangle : m_vertexTriangles[vertex])
+            {
+                if (!m_alive[triangle])
+                    continue;
+
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    const auto corner = m_corners[triangle * 3 + i];
+                    if (corner != vertex)
+                        neighbours.push_back(corner);
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        }
+
+        void PushEdge(const uint32_t a, const uint32_t b)
+        {
+            if (m_seam[a] && m_seam[b])
+                return;
+
+            const auto quadric = m_quadrics[a] + m_quadrics[b];
+            const auto a_to_b = m_seam[a] ? std::numeric_limits<double>::infinity() : quadric.Error(m_mesh.positions[b]);
+            const auto b_to_a = m_seam[b] ? std::numeric_limits<double>::infinity() : quadric.Error(m_mesh.positions[a]);
+            if (a_to_b <= b_to_a)
+                m_queue.push({ a_to_b, a, b, m_stamps[a], m_stamps[b] });
+            else
+                m_queue.push({ b_to_a, b, a, m_stamps[b], m_stamps[a] });
+        }
+
+        // Refuses collapses that would join surfaces touching only at this
+        // edge's ends or fold a triangle of from over.
+        bool CanCollapse(const uint32_t from, const uint32_t to)
+        {
+            size_t shared = 0;
+            for (const auto triangle : m_vertexTriangles[from])
+            {
+                if (m_alive[triangle] && Contains(triangle, to))
+                    ++shared;
+            }
+            if (shared == 0)
+                return false;
+
+            Neighbours(from, m_fromNeighbours);
+            Neighbours(to, m_toNeighbours);
+            auto f = m_fromNeighbours.cbegin();
+            auto t = m_toNeighbours.cbegin();
+            size_t common = 0;
+            while (f != m_fromNeighbours.end() && t != m_toNeighbours.end())
+            {
+                if (*f < *t)
+                    ++f;
+                else if (*t < *f)
+                    ++t;
+                else
+                {
+                    ++common;
+                    ++f;
+                    ++t;
+                }
+            }
+            if (common > shared)
+                return false;
+
+            for (const auto triangle : m_vertexTriangles[from])
+            {
+                if (!m_alive[triangle] || Contains(triangle, to))
+                    continue;
+
+                const auto before = TriangleNormal(triangle);
+                std::array<vec3f, 3> moved;
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    const auto corner = m_corners[triangle * 3 + i];
+                    moved[i] = m_mesh.positions[corner == from ? to : corner];
+                }
+                const auto after = Normal(moved[0], moved[1], moved[2]);
+                const double before_length = std::sqrt(static_cast<double>(dot(before, before)));
+                const double after_length = std::sqrt(static_cast<double>(dot(after, after)));
+                if (before_length == 0.)
+                    continue;
+                if (dot(before, after) <= min_normal_cos * before_length * after_length)
+                    return false;
+            }
+            return true;
+        }
+
+        void DoCollapse(const uint32_t from, const uint32_t to)
+        {
+            // Moved corners take the attributes to has next to from; as from
+            // is no seam, every triangle along the edge agrees on them.
+            uint32_t texture_index = 0;
+            uint32_t normal_index = 0;
+            for (const auto triangle : m_vertexTriangles[from])
+            {
+                if (!m_alive[triangle] || !Contains(triangle, to))
+                    continue;
+
+                for (size_t i = triangle * 3; i < triangle * 3 + 3; ++i)
+                {
+                    if (m_corners[i] == to)
+                    {
+                        texture_index = m_textureCorners[i];
+                        normal_index = m_normalCorners[i];
+                    }
+                }
+                break;
+            }
+
+            auto& to_triangles = m_vertexTriangles[to];
+            for (const auto triangle : m_vertexTriangles[from])
+            {
+                if (!m_alive[triangle])
+                    continue;
+
+                if (Contains(triangle, to))
+                {
+                    m_alive[triangle] = false;
+                    --m_live;
+                    continue;
+                }
+
+                for (size_t i = triangle * 3; i < triangle * 3 + 3; ++i)
+                {
+                    if (m_corners[i] == from)
+                    {
+                        m_corners[i] = to;
+                        m_textureCorners[i] = texture_index;
+                        m_normalCorners[i] = normal_index;
+                    }
+                }
+                to_triangles.push_back(triangle);
+            }
+            std::vector<uint32_t>().swap(m_vertexTriangles[from]);
+            to_triangles.erase(std::remove_if(to_triangles.begin(), to_triangles.end(),
+                [this](const uint32_t triangle) { return !m_alive[triangle]; }), to_triangles.end());
+
+            m_removed[from] = true;
+            m_quadrics[to] += m_quadrics[from];
+            ++m_stamps[to];
+
+            Neighbours(to, m_toNeighbours);
+            for (const auto neighbour : m_toNeighbours)
+            {
+                PushEdge(to, neighbour);
+            }
+        }
+
+        MeshLevelData Snapshot() const
+        {
+            MeshLevelData level;
+            level.error = static_cast<float_t>(std::sqrt(m_maxCost));
+            level.positionIndices.reserve(m_live * 3);
+            level.textureIndices.reserve(m_live * 3);
+            level.normalIndices.reserve(m_live * 3);
+            std::vector<uint32_t> remap(m_mesh.positions.size(), no_vertex);
+            for (size_t i = 0; i < m_corners.size(); ++i)
+            {
+                if (!m_alive[i / 3])
+                    continue;
+
+                auto& index = remap[m_corners[i]];
+                if (index == no_vertex)
+                {
+                    index = static_cast<uint32_t>(level.positions.size());
+                    level.positions.push_back(m_mesh.positions[m_corners[i]]);
+                }
+                level.positionIndices.push_back(index);
+                level.textureIndices.push_back(m_textureCorners[i]);
+                level.normalIndices.push_back(m_normalCorners[i]);
+            }
+            return level;
+        }
+
+    public:
+        explicit Simplifier(const MeshView& mesh)
+            : m_mesh(mesh)
+            , m_corners(mesh.positionIndices.begin(), mesh.positionIndices.end())
+            , m_textureCorners(mesh.textureIndices.begin(), mesh.textureIndices.end())
+            , m_normalCorners(mesh.normalIndices.begin(), mesh.normalIndices.end())
+            , m_alive(mesh.TriangleCount(), true)
+            , m_removed(mesh.positions.size(), false)
+            , m_seam(mesh.positions.size(), false)
+            , m_stamps(mesh.positions.size(), 0)
+            , m_quadrics(mesh.positions.size())
+            , m_vertexTriangles(mesh.positions.size())
+        {
+            std::vector<std::pair<uint32_t, uint32_t>> attributes(mesh.positions.size(), { no_vertex, no_vertex });
+            for (size_t i = 0; i < m_corners.size(); ++i)
+            {
+                auto& first = attributes[m_corners[i]];
+                const std::pair<uint32_t, uint32_t> corner{ m_textureCorners[i], m_normalCorners[i] };
+                if (first.first == no_vertex)
+                    first = corner;
+                else if (first != corner)
+                    m_seam[m_corners[i]] = true;
+            }
+
+            // Edges are sorted by their ends to find the ones only a single
+            // triangle has, which are borders.
+            std::vector<std::pair<uint64_t, uint32_t>> edges;
+            edges.reserve(m_corners.size());
+            for (uint32_t triangle = 0; triangle < m_alive.size(); ++triangle)
+            {
+                const auto first = triangle * 3;
+                const auto i0 = m_corners[first];
+                const auto i1 = m_corners[first + 1];
+                const auto i2 = m_corners[first + 2];
+                if (i0 == i1 || i1 == i2 || i2 == i0)
+                {
+                    m_alive[triangle] = false;
+                    continue;
+                }
+
+                ++m_live;
+                auto normal = TriangleNormal(triangle);
+                const auto length = std::sqrt(dot(normal, normal));
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    const auto a = m_corners[first + i];
+                    const auto b = m_corners[first + (i + 1) % 3];
+                    m_vertexTriangles[a].push_back(triangle);
+                    edges.emplace_back((uint64_t{ std::min(a, b) } << 32) | std::max(a, b), triangle);
+                }
+                if (length == 0.f)
+                    continue;
+
+                normal = normal / length;
+                const auto plane = Quadric::Plane(normal, m_mesh.positions[i0], 1.);
+                m_quadrics[i0] += plane;
+                m_quadrics[i1] += plane;
+                m_quadrics[i2] += plane;
+            }
+
+            std::sort(edges.begin(), edges.end());
+            for (size_t i = 0; i < edges.size();)
+            {
+                auto end = i + 1;
+                while (end < edges.size() && edges[end].first == edges[i].first)
+                {
+                    ++end;
+                }
+
+                const auto a = static_cast<uint32_t>(edges[i].first >> 32);
+                const auto b = static_cast<uint32_t>(edges[i].first);
+                if (end - i == 1)
+                {
+                    const auto face = TriangleNormal(edges[i].second);
+                    const auto side = cross(m_mesh.positions[b] - m_mesh.positions[a], face);
+                    const auto length = std::sqrt(dot(side, side));
+                    if (length > 0.f)
+                    {
+                        const auto plane = Quadric::Plane(side / length, m_mesh.positions[a], border_weight);
+                        m_quadrics[a] += plane;
+                        m_quadrics[b] += plane;
+                    }
+                }
+                i = end;
+            }
+
+            for (size_t i = 0; i < edges.size(); ++i)
+            {
+                if (i == 0 || edges[i].first != edges[i - 1].first)
+                    PushEdge(static_cast<uint32_t>(edges[i].first >> 32), static_cast<uint32_t>(edges[i].first));
+            }
+        }
+
+        std::vector<MeshLevelData> Run(const MeshLodOptions& options)
+        {
+            std::vector<MeshLevelData> levels;
+            auto previous = m_live;
+            auto target = static_cast<size_t>(previous * options.reduction);
+            while (target >= options.minTriangles)
+            {
+                while (m_live > target && !m_queue.empty())
+                {
+                    const auto collapse = m_queue.top();
+                    m_queue.pop();
+                    if (m_removed[collapse.from] || m_removed[collapse.to]
+                        || m_stamps[collapse.from] != collapse.fromStamp || m_stamps[collapse.to] != collapse.toStamp
+                        || !CanCollapse(collapse.from, collapse.to))
+                        continue;
+
+                    m_maxCost = std::max(m_maxCost, collapse.cost);
+                    DoCollapse(collapse.from, collapse.to);
+                }
+
+                // A mesh that ran out of collapses ends the chain, with a last
+                // level only if it got noticeably smaller.
+                const auto stuck = m_live > target;
+                if (!stuck || m_live * 10 < previous * 9)
+                    levels.push_back(Snapshot());
+                if (stuck)
+                    break;
+
+                previous = m_live;
+                target = static_cast<size_t>(previous * options.reduction);
+            }
+            return levels;
+        }
+    };
+}
+
+MeshLevel MeshLevelData::View(const MeshView& full) const
+{
+    return {
+        { { positions.data(), positions.size() },
+          full.textureCoords,
+          full.normals,
+          { positionIndices.data(), positionIndices.size() },
+          { textureIndices.data(), textureIndices.size() },
+          { normalIndices.data(), normalIndices.size() } },
+        error };
+}
+
+std::vector<MeshLevelData> BuildMeshLevels(const MeshView& mesh, const MeshLodOptions& options)
+{
+    return Simplifier(mesh).Run(options);
+}
+
+MeshView SelectLevel(const IModel& model, const ImageSize& size, const float_t max_error)
+{
+    auto mesh = model.GetMesh();
+    if (max_error <= 0.f)
+        return mesh;
+
+    // Object space -1..1 spans the picture, so a unit is half of it in pixels.
+    const auto[width, height] = size;
+    const auto pixels_per_unit = static_cast<float_t>(std::max(width, height)) / 2.f;
+    for (const auto& level : model.GetLevels())
+    {
+        if (level.error * pixels_per_unit > max_error)
+            break;
+        mesh = level.mesh;
+    }
+    return mesh;
+}
+
+LodModel::LodModel(std::unique_ptr<IModel> model, const MeshLodOptions& options)
+    : m_model(std::move(model))
+    , m_options(options)
+{}
+
+void LodModel::ReadModel(const std::filesystem::path& path_to_model)
+{
+    m_model->ReadModel(path_to_model);
+    m_levels.clear();
+    m_data.clear();
+    if (m_model->GetLevels().size() > 0)
+        return;
+
+    const auto mesh = m_model->GetMesh();
+    m_data = BuildMeshLevels(mesh, m_options);
+    for (const auto& level : m_data)
+    {
+        m_levels.push_back(level.View(mesh));
+    }
+}
+
+ArrayView<MeshLevel> LodModel::GetLevels() const
+{
+    if (m_levels.empty())
+        return m_model->GetLevels();
+    return { m_levels.data(), m_levels.size() };
+}
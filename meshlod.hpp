@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "img.hpp"
+#include "model.hpp"
+
+// Positions and index buffers of one simplified level. Texture coordinates
+// and normals are those of the full mesh; only the positions left after
+// simplification are kept, so transforming a level costs what its size does.
+struct MeshLevelData
+{
+    std::vector<vec3f> positions;
+    std::vector<uint32_t> positionIndices;
+    std::vector<uint32_t> textureIndices;
+    std::vector<uint32_t> normalIndices;
+    float_t error = 0.f;
+
+    MeshLevel View(const MeshView& full) const;
+};
+
+struct MeshLodOptions
+{
+    // Each level keeps about this share of the triangles of the one before.
+    float_t reduction = .25f;
+    // No level is made with fewer triangles than this.
+    size_t minTriangles = 256;
+};
+
+// Builds a chain of ever coarser levels by collapsing the edges whose
+// quadric error is smallest, moving one end onto the other along with its
+// texture coordinates and normal. Open borders are held in place, vertices
+// on texture or normal seams don't move, and collapses folding a triangle
+// over are refused, so the chain stops early on meshes that can't be
+// simplified further.
+std::vector<MeshLevelData> BuildMeshLevels(const MeshView& mesh, const MeshLodOptions& options = {});
+
+// Coarsest level of model whose error, projected at size, is at most
+// max_error pixels; the full mesh when there is none or max_error is 0.
+MeshView SelectLevel(const IModel& model, const ImageSize& size, const float_t max_error);
+
+// Reads a model and builds its levels once, unless it comes with levels of
+// its own like a .bmesh baked with them.
+class LodModel : public IModel
+{
+    std::unique_ptr<IModel> m_model;
+    MeshLodOptions m_options;
+    std::vector<MeshLevelData> m_data;
+    std::vector<MeshLevel> m_levels;
+public:
+    explicit LodModel(std::unique_ptr<IModel> model, const MeshLodOptions& options = {});
+
+    virtual void ReadModel(const std::filesystem::path& path_to_model) override;
+    virtual MeshView GetMesh() const override { return m_model->GetMesh(); }
+    virtual ArrayView<MeshLevel> GetLevels() const override;
+};
@@ -0,0 +1,235 @@
+#include "meshorder.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t no_index = std::numeric_limits<uint32_t>::max();
+
+    // Spreads the low 10 bits of x to every third bit.
+    uint32_t SpreadBits(uint32_t x)
+    {
+        x &= 0x3ff;
+        x = (x | (x << 16)) & 0x030000ff;
+        x = (x | (x << 8)) & 0x0300f00f;
+        x = (x | (x << 4)) & 0x030c30c3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    }
+
+    std::vector<uint32_t> SpatialOrder(const MeshView& mesh, const std::vector<uint32_t>& triangles)
+    {
+        vec3f low{ std::numeric_limits<float_t>::max(), std::numeric_limits<float_t>::max(), std::numeric_limits<float_t>::max() };
+        vec3f high{ std::numeric_limits<float_t>::lowest(), std::numeric_limits<float_t>::lowest(), std::numeric_limits<float_t>::lowest() };
+        for (const auto& position : mesh.positions)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                low[i] = std::min(low[i], position[i]);
+                high[i] = std::max(high[i], position[i]);
+            }
+        }
+
+        std::vector<std::pair<uint32_t, uint32_t>> keys;
+        keys.reserve(triangles.size());
+        for (const auto triangle : triangles)
+        {
+            const auto first = triangle * size_t{ 3 };
+            const auto centroid = (mesh.positions[mesh.positionIndices[first]]
+                + mesh.positions[mesh.positionIndices[first + 1]]
+                + mesh.positions[mesh.positionIndices[first + 2]]) / 3.f;
+            uint32_t code = 0;
+            for (size_t i = 0; i < 3; ++i)
+            {
+                const auto extent = high[i] - low[i];
+                const auto cell = extent > 0.f ? (centroid[i] - low[i]) / extent * 1023.f : 0.f;
+                code |= SpreadBits(static_cast<uint32_t>(std::clamp(cell, 0.f, 1023.f))) << i;
+            }
+            keys.emplace_back(code, triangle);
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<uint32_t> order;
+        order.reserve(keys.size());
+        for (const auto& key : keys)
+        {
+            order.push_back(key.second);
+        }
+        return order;
+    }
+
+    // Tipsify (Sander, Nehab and Barczak): fans out around a vertex, then
+    // moves to the vertex of that fan that will still be in the cache when
+    // its own fan is done, falling back to recently used vertices with
+    // triangles left and finally to the next vertex in the incoming order.
+    std::vector<uint32_t> VertexCacheOrder(const MeshView& mesh, const std::vector<uint32_t>& triangles, const size_t cache_size)
+    {
+        const auto vertex_count = mesh.positions.size();
+        std::vector<uint32_t> live(vertex_count, 0);
+        std::vector<uint32_t> visit_order;
+        for (const auto triangle : triangles)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                const auto vertex = mesh.positionIndices[triangle * size_t{ 3 } + i];
+                if (live[vertex]++ == 0)
+                    visit_order.push_back(vertex);
+            }
+        }
+
+        std::vector<size_t> first_adjacent(vertex_count + 1, 0);
+        for (size_t vertex = 0; vertex < vertex_count; ++vertex)
+        {
+            first_adjacent[vertex + 1] = first_adjacent[vertex] + live[vertex];
+        }
+        std::vector<uint32_t> adjacent(first_adjacent.back());
+        auto next_adjacent = first_adjacent;
+        for (const auto triangle : triangles)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                adjacent[next_adjacent[mesh.positionIndices[triangle * size_t{ 3 } + i]]++] = triangle;
+            }
+        }
+
+        std::vector<size_t> cache_time(vertex_count, 0);
+        size_t time = cache_size + 1;
+        std::vector<bool> emitted(mesh.TriangleCount(), false);
+        std::vector<uint32_t> dead_ends;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> order;
+        order.reserve(triangles.size());
+        size_t cursor = 0;
+        auto fanning = visit_order.empty() ? no_index : visit_order[0];
+        while (fanning != no_index)
+        {
+            candidates.clear();
+            for (auto k = first_adjacent[fanning]; k < first_adjacent[fanning + 1]; ++k)
+            {
+                const auto triangle = adjacent[k];
+                if (emitted[triangle])
+                    continue;
+
+                emitted[triangle] = true;
+                order.push_back(triangle);
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    const auto vertex = mesh.positionIndices[triangle * size_t{ 3 } + i];
+                    dead_ends.push_back(vertex);
+                    candidates.push_back(vertex);
+                    --live[vertex];
+                    if (time - cache_time[vertex] > cache_size)
+                        cache_time[vertex] = time++;
+                }
+            }
+
+            fanning = no_index;
+            int64_t best = -1;
+            for (const auto vertex : candidates)
+            {
+                if (live[vertex] == 0)
+                    continue;
+
+                int64_t priority = 0;
+                if (time - cache_time[vertex] + 2 * live[vertex] <= cache_size)
+                    priority = static_cast<int64_t>(time - cache_time[vertex]);
+                if (priority > best)
+                {
+                    best = priority;
+                    fanning = vertex;
+                }
+            }
+
+            while (fanning == no_index && !dead_ends.empty())
+            {
+                const auto vertex = dead_ends.back();
+                dead_ends.pop_back();
+                if (live[vertex] > 0)
+                    fanning = vertex;
+            }
+            while (fanning == no_index && cursor < visit_order.size())
+            {
+                const auto vertex = visit_order[cursor++];
+                if (live[vertex] > 0)
+                    fanning = vertex;
+            }
+        }
+        return order;
+    }
+
+    // Copies the attributes indices refer to in order of first use.
+    template <typename T>
+    void Renumber(const ArrayView<T>& attributes, const ArrayView<uint32_t>& indices,
+        const std::vector<uint32_t>& order, std::vector<T>& new_attributes, std::vector<uint32_t>& new_indices)
+    {
+        std::vector<uint32_t> remap(attributes.size(), no_index);
+        new_indices.reserve(order.size() * 3);
+        for (const auto triangle : order)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                const auto index = indices[triangle * size_t{ 3 } + i];
+                auto& new_index = remap[index];
+                if (new_index == no_index)
+                {
+                    new_index = static_cast<uint32_t>(new_attributes.size());
+                    new_attributes.push_back(attributes[index]);
+                }
+                new_indices.push_back(new_index);
+            }
+        }
+    }
+}
+
+Mesh ReorderMesh(const MeshView& mesh, const MeshOrderOptions& options)
+{
+    std::vector<uint32_t> order(mesh.TriangleCount());
+    std::iota(order.begin(), order.end(), 0);
+    if (options.spatial)
+        order = SpatialOrder(mesh, order);
+    if (options.vertexCache)
+        order = VertexCacheOrder(mesh, order, options.cacheSize);
+
+    Mesh reordered;
+    Renumber(mesh.positions, mesh.positionIndices, order, reordered.positions, reordered.positionIndices);
+    Renumber(mesh.textureCoords, mesh.textureIndices, order, reordered.textureCoords, reordered.textureIndices);
+    Renumber(mesh.normals, mesh.normalIndices, order, reordered.normals, reordered.normalIndices);
+    return reordered;
+}
+
+float_t VertexCacheMissRatio(const MeshView& mesh, const size_t cache_size)
+{
+    if (mesh.TriangleCount() == 0)
+        return 0.f;
+
+    std::vector<uint32_t> cache(cache_size, no_index);
+    size_t oldest = 0;
+    size_t misses = 0;
+    for (const auto vertex : mesh.positionIndices)
+    {
+        if (std::find(cache.begin(), cache.end(), vertex) != cache.end())
+            continue;
+
+        ++misses;
+        cache[oldest] = vertex;
+        oldest = (oldest + 1) % cache_size;
+    }
+    return static_cast<float_t>(misses) / mesh.TriangleCount();
+}
+
+ReorderedModel::ReorderedModel(std::unique_ptr<IModel> model, const MeshOrderOptions& options)
+    : m_model(std::move(model))
+    , m_options(options)
+{}
+
+void ReorderedModel::ReadModel(const std::filesystem::path& path_to_model)
+{
+    if (!m_model)
+        throw std::runtime_error("Reordered model was already read");
+
+    m_model->ReadModel(path_to_model);
+    m_mesh = ReorderMesh(m_model->GetMesh(), m_options);
+    m_model.reset();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include "model.hpp"
+
+struct MeshOrderOptions
+{
+    // Sorts triangles by the Morton code of their centroids first, so
+    // neighbours on screen are drawn close together.
+    bool spatial = true;
+    // Then reorders them to reuse recently fetched vertices, keeping the
+    // coarse order of the sort.
+    bool vertexCache = true;
+    size_t cacheSize = 16;
+};
+
+// Copy of mesh with its triangles reordered for locality, corners kept in
+// their order, and positions, texture coordinates and normals renumbered in
+// the order the triangles first use them; unused ones are dropped. The
+// picture only changes where triangles tie in depth.
+Mesh ReorderMesh(const MeshView& mesh, const MeshOrderOptions& options = {});
+
+// Positions a FIFO cache of cache_size vertices misses, per triangle: 3 when
+// no vertex is reused, approaching 0.5 for long strips of a regular grid.
+float_t VertexCacheMissRatio(const MeshView& mesh, const size_t cache_size = 16);
+
+// Reads a model, keeps a reordered copy of its mesh and lets go of the model
+// read, so only one copy stays in memory and a model can be read only once.
+// Levels of the model read aren't passed on; a LodModel around this one
+// builds its own.
+class ReorderedModel : public IModel
+{
+    std::unique_ptr<IModel> m_model;
+    MeshOrderOptions m_options;
+    Mesh m_mesh;
+public:
+    explicit ReorderedModel(std::unique_ptr<IModel> model, const MeshOrderOptions& options = {});
+
+    virtual void ReadModel(const std::filesystem::path& path_to_model) override;
+    virtual MeshView GetMesh() const override { return m_mesh.View(); }
+};
@@ -1,8 +1,9 @@
 #pragma once
 
 #include "hola/hola.hpp"
+#include <cstdint>
 #include <filesystem>
-#include <optional>
+#include <vector>
 
 using namespace hola;
 
@@ -15,15 +16,84 @@ struct TriangulatePolygon
     TextureCoords textureCoordinates;
 };
 
-struct IShape
+template <typename T>
+struct ArrayView
 {
-    virtual std::optional<TriangulatePolygon> GetNextPolygon() const = 0;
-    virtual ~IShape() = default;
+    const T* data = nullptr;
+    size_t count = 0;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + count; }
+    size_t size() const { return count; }
+    const T& operator[](const size_t i) const { return data[i]; }
+};
+
+// Read-only view of a flattened triangle mesh. Attributes are contiguous
+// arrays and every triangle is three entries in each index buffer, so the
+// mesh can be read concurrently and traversed any number of times. The
+// storage belongs to the model, which may be an owning Mesh or a mapped file.
+struct MeshView
+{
+    ArrayView<vec3f> positions;
+    ArrayView<vec2f> textureCoords;
+    ArrayView<vec3f> normals;
+    ArrayView<uint32_t> positionIndices;
+    ArrayView<uint32_t> textureIndices;
+    ArrayView<uint32_t> normalIndices;
+
+    size_t TriangleCount() const { return positionIndices.size() / 3; }
+
+    TriangulatePolygon GetPolygon(const size_t triangle) const
+    {
+        const auto first = triangle * 3;
+        return {
+            { positions[positionIndices[first]],
+              positions[positionIndices[first + 1]],
+              positions[positionIndices[first + 2]] },
+            { textureCoords[textureIndices[first]],
+              textureCoords[textureIndices[first + 1]],
+              textureCoords[textureIndices[first + 2]] } };
+    }
+};
+
+// Flattened triangle mesh built once at load time.
+struct Mesh
+{
+    std::vector<vec3f> positions;
+    std::vector<vec2f> textureCoords;
+    std::vector<vec3f> normals;
+    std::vector<uint32_t> positionIndices;
+    std::vector<uint32_t> textureIndices;
+    std::vector<uint32_t> normalIndices;
+
+    size_t TriangleCount() const { return positionIndices.size() / 3; }
+
+    MeshView View() const
+    {
+        return {
+            { positions.data(), positions.size() },
+            { textureCoords.data(), textureCoords.size() },
+            { normals.data(), normals.size() },
+            { positionIndices.data(), positionIndices.size() },
+            { textureIndices.data(), textureIndices.size() },
+            { normalIndices.data(), normalIndices.size() } };
+    }
+};
+
+// Simplified version of a mesh and how far, in object space, its surface may
+// lie from the full one.
+struct MeshLevel
+{
+    MeshView mesh;
+    float_t error;
 };
 
 struct IModel
 {
     virtual void ReadModel(const std::filesystem::path& path_to_model) = 0;
-    virtual std::unique_ptr<IShape> GetNextShape() const = 0;
+    virtual MeshView GetMesh() const = 0;
+    // Simplified levels of GetMesh, coarsest last; models have none unless
+    // they were built or cached for it.
+    virtual ArrayView<MeshLevel> GetLevels() const { return {}; }
     virtual ~IModel() = default;
 };
@@ -0,0 +1,75 @@
+#include "multisample.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void MultisampleBuffer::SetSampleCount(const uint32_t samples)
+{
+    if (samples != 1 && samples != 4 && samples != 8)
+        throw std::runtime_error("Sample count must be 1, 4 or 8");
+
+    m_samples = samples;
+}
+
+void MultisampleBuffer::Reset(const ConstPixelView& pixels)
+{
+    m_width = pixels.width;
+    m_height = pixels.height;
+    m_bytesPerPixel = pixels.bytesPerPixel;
+    const auto pixel_count = pixels.width * pixels.height;
+    m_depth.assign(pixel_count * m_samples, Float32Depth::clear);
+    m_color.resize(pixel_count * m_samples * m_bytesPerPixel);
+
+    auto sample = m_color.data();
+    for (size_t p = 0; p < pixel_count; ++p)
+    {
+        const auto pixel = pixels.data + p * m_bytesPerPixel;
+        for (uint32_t s = 0; s < m_samples; ++s, sample += m_bytesPerPixel)
+        {
+            std::memcpy(sample, pixel, m_bytesPerPixel);
+        }
+    }
+}
+
+void MultisampleBuffer::Shade(const int32_t x, const int32_t y, const uint32_t mask, float_t intensity, const RGBA& color)
+{
+    intensity = intensity > 1.f ? 1.f : (intensity < 0.f ? 0.f : intensity);
+    const uint8_t bgra[4] = {
+        static_cast<uint8_t>(color.b * intensity),
+        static_cast<uint8_t>(color.g * intensity),
+        static_cast<uint8_t>(color.r * intensity),
+        static_cast<uint8_t>(color.a * intensity) };
+
+    auto sample = m_color.data() + FirstSample(x, y) * m_bytesPerPixel;
+    for (uint32_t s = 0; s < m_samples; ++s, sample += m_bytesPerPixel)
+    {
+        if (mask & (1u << s))
+            std::memcpy(sample, bgra, m_bytesPerPixel);
+    }
+}
+
+void MultisampleBuffer::ResolveRow(const PixelView& pixels, const Height y) const
+{
+    auto sample = m_color.data() + FirstSample(0, static_cast<int32_t>(y)) * m_bytesPerPixel;
+    auto pixel = pixels.Pixel(0, static_cast<int32_t>(y));
+    for (size_t x = 0; x < m_width; ++x, pixel += m_bytesPerPixel)
+    {
+        uint32_t sums[4] = { 0, 0, 0, 0 };
+        for (uint32_t s = 0; s < m_samples; ++s, sample += m_bytesPerPixel)
+        {
+            for (size_t c = 0; c < m_bytesPerPixel; ++c)
+            {
+                sums[c] += sample[c];
+            }
+        }
+        for (size_t c = 0; c < m_bytesPerPixel; ++c)
+        {
+            pixel[c] = static_cast<uint8_t>((sums[c] + m_samples / 2) / m_samples);
+        }
+    }
+}
+
+size_t MultisampleBuffer::MemoryBytes() const
+{
+    return m_depth.capacity() * sizeof(float_t) + m_color.capacity();
+}
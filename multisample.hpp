@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "img.hpp"
+#include "rasterizer.hpp"
+
+// Standard 4x and 8x sample positions in 1/16 pixel, around the point
+// single sampled rendering tests. Both patterns are centred on it, so a
+// pixel whose samples are all covered is shaded exactly where it would be
+// without multisampling.
+template <uint32_t Samples>
+struct SamplePattern;
+
+template <>
+struct SamplePattern<4>
+{
+    static constexpr std::array<std::array<int32_t, 2>, 4> offsets{ { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } } };
+};
+
+template <>
+struct SamplePattern<8>
+{
+    static constexpr std::array<std::array<int32_t, 2>, 8> offsets{ {
+        { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } } };
+};
+
+constexpr int32_t sample_position_bits = 4;
+
+// Colour and depth of every sample of a multisampled render, the samples of
+// a pixel next to each other. Reset loads every sample with the colour of
+// its pixel, so pixels nothing covers resolve to what they were.
+class MultisampleBuffer
+{
+    uint32_t m_samples = 1;
+    Width m_width = 0;
+    Height m_height = 0;
+    size_t m_bytesPerPixel = 3;
+    std::vector<float_t> m_depth;
+    std::vector<uint8_t> m_color;
+
+    size_t FirstSample(const int32_t x, const int32_t y) const
+    {
+        return (static_cast<size_t>(x) + static_cast<size_t>(y) * m_width) * m_samples;
+    }
+
+public:
+    // 1 turns multisampling off; 4 and 8 are supported.
+    void SetSampleCount(const uint32_t samples);
+    uint32_t GetSampleCount() const { return m_samples; }
+
+    // Takes the size and colour of pixels and clears depth, keeping the
+    // storage when the sample count doesn't grow.
+    void Reset(const ConstPixelView& pixels);
+
+    float_t* Depth(const int32_t x, const int32_t y) { return m_depth.data() + FirstSample(x, y); }
+
+    // Shades the samples in mask the way PixelView::Set shades a pixel.
+    void Shade(const int32_t x, const int32_t y, const uint32_t mask, float_t intensity, const RGBA& color);
+
+    // Averages the samples of one row into pixels, rounding to nearest.
+    void ResolveRow(const PixelView& pixels, const Height y) const;
+    size_t MemoryBytes() const;
+};
+
+// Pixels with a sample the triangle may cover: its bounds grown by one pixel
+// on each side, as samples reach almost half a pixel out, then clipped.
+inline std::optional<PixelRegion> MultisampleRegion(const TriangleSetup& setup, const BoundingBox& clip)
+{
+    auto grown = setup;
+    grown.minX -= 1;
+    grown.minY -= 1;
+    grown.maxX += 1;
+    grown.maxY += 1;
+    return ClipRegion(grown, clip);
+}
+
+// Tests the coverage and depth of each sample of each pixel, stores the
+// depth of the samples that pass and calls shade(x, y, barycentric, mask)
+// once per pixel with any, giving the barycentrics of the covered samples'
+// centroid. Counts pixels rather than samples.
+template <uint32_t Samples, typename ShadeFunc>
+FragmentCount RasterizeMultisampled(const TriangleSetup& setup,
+    const BoundingBox& clip,
+    MultisampleBuffer& samples,
+    ShadeFunc&& shade)
+{
+    const auto region = MultisampleRegion(setup, clip);
+    if (!region)
+        return {};
+
+    constexpr auto& offsets = SamplePattern<Samples>::offsets;
+    constexpr auto position_scale = 1.f / (1 << sample_position_bits);
+    constexpr uint32_t all_samples = (1u << Samples) - 1;
+
+    // Per sample steps of each edge and of depth from the pixel's own value.
+    // With the smallest and largest edge step, pixels wholly inside or outside
+    // an edge skip the per sample tests.
+    std::array<std::array<int64_t, Samples>, 3> edge_offsets;
+    std::array<int64_t, 3> min_offset;
+    std::array<int64_t, 3> max_offset;
+    std::array<float_t, Samples> z_offsets;
+    const auto dz_dx = setup.z[0] * setup.barycentric[0].dx + setup.z[1] * setup.barycentric[1].dx + setup.z[2] * setup.barycentric[2].dx;
+    const auto dz_dy = setup.z[0] * setup.barycentric[0].dy + setup.z[1] * setup.barycentric[1].dy + setup.z[2] * setup.barycentric[2].dy;
+    for (size_t s = 0; s < Samples; ++s)
+    {
+        z_offsets[s] = offsets[s][0] * position_scale * dz_dx + offsets[s][1] * position_scale * dz_dy;
+    }
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const auto& edge = setup.edges[i];
+        for (size_t s = 0; s < Samples; ++s)
+        {
+            edge_offsets[i][s] = (edge.a * offsets[s][0] + edge.b * offsets[s][1])
+                * (int64_t{ 1 } << (subpixel_bits - sample_position_bits));
+        }
+        min_offset[i] = *std::min_element(edge_offsets[i].begin(), edge_offsets[i].end());
+        max_offset[i] = *std::max_element(edge_offsets[i].begin(), edge_offsets[i].end());
+    }
+
+    const auto step_x0 = EdgeStepX(setup.edges[0]);
+    const auto step_x1 = EdgeStepX(setup.edges[1]);
+    const auto step_x2 = EdgeStepX(setup.edges[2]);
+    FragmentCount count;
+    for (auto y = region->minY; y <= region->maxY; ++y)
+    {
+        const auto scanline = StartScanline(setup, region->minX, y);
+        auto[w0, w1, w2] = scanline.w;
+        auto depth = samples.Depth(region->minX, y);
+        for (auto x = region->minX; x <= region->maxX; ++x, depth += Samples)
+        {
+            const auto outside = ((w0 + max_offset[0]) | (w1 + max_offset[1]) | (w2 + max_offset[2])) < 0;
+            const auto inside = ((w0 + min_offset[0]) | (w1 + min_offset[1]) | (w2 + min_offset[2])) >= 0;
+            uint32_t covered = 0;
+            if (inside)
+            {
+                covered = all_samples;
+            }
+            else if (!outside)
+            {
+                for (size_t s = 0; s < Samples; ++s)
+                {
+                    if (((w0 + edge_offsets[0][s]) | (w1 + edge_offsets[1][s]) | (w2 + edge_offsets[2][s])) >= 0)
+                        covered |= 1u << s;
+                }
+            }
+
+            w0 += step_x0;
+            w1 += step_x1;
+            w2 += step_x2;
+            if (covered == 0)
+                continue;
+
+            ++count.covered;
+            const auto pixel = PixelBarycentric(setup, scanline, x);
+            const auto z = InterpolateDepth(setup, pixel);
+            uint32_t passed = 0;
+            int32_t sum_x = 0;
+            int32_t sum_y = 0;
+            for (size_t s = 0; s < Samples; ++s)
+            {
+                if ((covered & (1u << s)) == 0)
+                    continue;
+
+                sum_x += offsets[s][0];
+                sum_y += offsets[s][1];
+                const auto sample_z = z + z_offsets[s];
+                if (depth[s] < sample_z)
+                {
+                    depth[s] = sample_z;
+                    passed |= 1u << s;
+                }
+            }
+            if (passed == 0)
+                continue;
+
+            ++count.passed;
+            if (covered == all_samples)
+            {
+                shade(x, y, pixel, passed);
+                continue;
+            }
+
+            const auto samples_covered = static_cast<float_t>(std::bitset<Samples>(covered).count());
+            const auto cx = sum_x * position_scale / samples_covered;
+            const auto cy = sum_y * position_scale / samples_covered;
+            vec3f centroid;
+            for (size_t i = 0; i < 3; ++i)
+            {
+                centroid[i] = pixel[i] + cx * setup.barycentric[i].dx + cy * setup.barycentric[i].dy;
+            }
+            shade(x, y, centroid, passed);
+        }
+    }
+    return count;
+}
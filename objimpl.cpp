@@ -1,66 +1,101 @@
 #include "objimpl.hpp"
+#include "objparser.hpp"
+#include "mappedfile.hpp"
+#include <algorithm>
+#include <thread>
+#include "tinyobjloader/tiny_obj_loader.h"
 
-void Obj::ReadModel(const std::filesystem::path& path_to_model)
+void MappedObj::ReadModel(const std::filesystem::path& path_to_model)
 {
     if (path_to_model.extension() != ".obj")
         throw std::runtime_error("Invalid file provided, should be .obj");
 
-    m_objReader.ParseFromFile(path_to_model.string());
-    if (!m_objReader.Valid())
-        throw std::runtime_error("Failed to read .obj file, reason:\n" + m_objReader.Error());
+    const MappedFile file(path_to_model);
+    constexpr size_t min_chunk_size = 1 << 20;
+    const auto chunk_count = std::min<size_t>(m_threadCount, file.Size() / min_chunk_size + 1);
+    m_mesh = ParseObj(file.Data(), file.Size(), chunk_count);
 }
 
-std::unique_ptr<IShape> Obj::GetNextShape() const
+void Obj::ReadModel(const std::filesystem::path& path_to_model)
 {
-    const auto shapes_it = m_objReader.GetShapes().begin() + current_shape;
-    if (shapes_it != m_objReader.GetShapes().end())
+    if (path_to_model.extension() != ".obj")
+        throw std::runtime_error("Invalid file provided, should be .obj");
+
+    tinyobj::ObjReader obj_reader;
+    obj_reader.ParseFromFile(path_to_model.string());
+    if (!obj_reader.Valid())
+        throw std::runtime_error("Failed to read .obj file, reason:\n" + obj_reader.Error());
+
+    const auto& attrib = obj_reader.GetAttrib();
+    Mesh mesh;
+    mesh.positions.reserve(attrib.vertices.size() / 3);
+    for (size_t i = 0; i + 2 < attrib.vertices.size(); i += 3)
     {
-        ++current_shape;
-        return std::make_unique<Shape>(
-            *shapes_it, m_objReader.GetAttrib().vertices, m_objReader.GetAttrib().texcoords);
+        mesh.positions.push_back(
+            vec3f{ attrib.vertices[i], attrib.vertices[i + 1], attrib.vertices[i + 2] });
     }
-    else
+
+    mesh.textureCoords.reserve(attrib.texcoords.size() / 2 + 1);
+    for (size_t i = 0; i + 1 < attrib.texcoords.size(); i += 2)
     {
-        return nullptr;
+        mesh.textureCoords.push_back(vec2f{ attrib.texcoords[i], attrib.texcoords[i + 1] });
     }
-}
-
-vec3f Shape::GetVertex(const uint32_t idx) const
-{
-    const auto start_idx = idx * 3;
-    return vec3f{ m_vertices[start_idx],
-        m_vertices[start_idx + 1],
-        m_vertices[start_idx + 2] };
-}
-
-vec2f Shape::GetTextureCoord(const uint32_t idx) const
-{
-    const auto start_idx = idx * 2;
-    return vec2f{ m_texCoords[start_idx], m_texCoords[start_idx + 1] };
-}
 
-std::optional<TriangulatePolygon> Shape::GetNextPolygon() const
-{
-    auto polygon = TriangulatePolygon{};
-    const auto faces_it = m_numFaceVertices.begin() + current_face;
-    if (faces_it != m_numFaceVertices.end())
+    mesh.normals.reserve(attrib.normals.size() / 3 + 1);
+    for (size_t i = 0; i + 2 < attrib.normals.size(); i += 3)
     {
-        const auto face_size = *faces_it;
-        if (face_size != 3)
-            throw std::runtime_error("Obj file not triangulated, aborting...");
+        mesh.normals.push_back(
+            vec3f{ attrib.normals[i], attrib.normals[i + 1], attrib.normals[i + 2] });
+    }
 
-        const auto face = m_indices.begin() + current_face*face_size;
-        for (int i = 0; i < face_size; ++i)
+    // Faces without texture coordinates or normals point at one extra zero
+    // entry appended to the attribute array.
+    const auto missing_texcoord = static_cast<uint32_t>(mesh.textureCoords.size());
+    const auto missing_normal = static_cast<uint32_t>(mesh.normals.size());
+    bool has_missing_texcoord = false;
+    bool has_missing_normal = false;
+    for (const auto& shape : obj_reader.GetShapes())
+    {
+        for (const auto face_size : shape.mesh.num_face_vertices)
         {
-            polygon.vertices[i] = GetVertex(face[i].vertex_index);
-            polygon.textureCoordinates[i] = GetTextureCoord(face[i].texcoord_index);
+            if (face_size != 3)
+                throw std::runtime_error("Obj file not triangulated, aborting...");
         }
 
-        ++current_face;
-        return polygon;
-    }
-    else
-    {
-        return std::nullopt;
+        for (const auto& index : shape.mesh.indices)
+        {
+            mesh.positionIndices.push_back(static_cast<uint32_t>(index.vertex_index));
+            if (index.texcoord_index >= 0)
+            {
+                mesh.textureIndices.push_back(static_cast<uint32_t>(index.texcoord_index));
+            }
+            else
+            {
+                mesh.textureIndices.push_back(missing_texcoord);
+                has_missing_texcoord = true;
+            }
+
+            if (index.normal_index >= 0)
+            {
+                mesh.normalIndices.push_back(static_cast<uint32_t>(index.normal_index));
+            }
+            else
+            {
+                mesh.normalIndices.push_back(missing_normal);
+                has_missing_normal = true;
+            }
+        }
     }
+
+    if (has_missing_texcoord)
+        mesh.textureCoords.push_back(vec2f{ 0.f, 0.f });
+    if (has_missing_normal)
+        mesh.normals.push_back(vec3f{ 0.f, 0.f, 0.f });
+
+    m_mesh = std::move(mesh);
+}
+
+MappedObj::MappedObj(const uint32_t thread_count) :
+    m_threadCount(thread_count != 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency()))
+{
 }
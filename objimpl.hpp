@@ -1,37 +1,25 @@
 #pragma once
 
 #include "model.hpp"
-#include "tinyobjloader/tiny_obj_loader.h"
 
 class Obj : public IModel
 {
-    tinyobj::ObjReader m_objReader;
-    mutable size_t current_shape = 0;
+    Mesh m_mesh;
 public:
     virtual void ReadModel(const std::filesystem::path& path_to_model) override;
-    virtual std::unique_ptr<IShape> GetNextShape() const override;
+    virtual MeshView GetMesh() const override { return m_mesh.View(); }
 };
 
-class Shape : public IShape
+// Native loader: memory maps the file and parses line-aligned chunks of it
+// in parallel. Accepts the same triangulated files as Obj and produces an
+// identical mesh.
+class MappedObj : public IModel
 {
-    const std::vector<tinyobj::index_t>& m_indices;
-    const std::vector<unsigned char>& m_numFaceVertices;
-    const std::vector<float_t>& m_vertices;
-    const std::vector<float_t>& m_texCoords;
-    mutable size_t current_face = 0;
-
-    vec3f GetVertex(const uint32_t idx) const;
-    vec2f GetTextureCoord(const uint32_t idx) const;
+    Mesh m_mesh;
+    uint32_t m_threadCount;
 public:
-    Shape(const tinyobj::shape_t& shape,
-        const std::vector<float_t>& vertices,
-        const std::vector<float_t>& tex_coords) :
-            m_indices(shape.mesh.indices),
-            m_numFaceVertices(shape.mesh.num_face_vertices),
-            m_vertices(vertices),
-            m_texCoords(tex_coords)
-    {
-    }
+    explicit MappedObj(const uint32_t thread_count = 0);
 
-    virtual std::optional<TriangulatePolygon> GetNextPolygon() const override;
+    virtual void ReadModel(const std::filesystem::path& path_to_model) override;
+    virtual MeshView GetMesh() const override { return m_mesh.View(); }
 };
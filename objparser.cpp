@@ -0,0 +1,301 @@
+#include "objparser.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+    enum Attribute
+    {
+        Position,
+        Texture,
+        Normal,
+        AttributeCount
+    };
+
+    constexpr int64_t missing_index = std::numeric_limits<int64_t>::min();
+
+    struct ChunkData
+    {
+        std::vector<vec3f> positions;
+        std::vector<vec2f> textureCoords;
+        std::vector<vec3f> normals;
+        // Zero-based index per face vertex. Negative OBJ indices can only be
+        // resolved against the chunk's own attribute count here; their slots
+        // are listed in chunkRelative and offset during the merge.
+        std::array<std::vector<int64_t>, AttributeCount> indices;
+        std::array<std::vector<size_t>, AttributeCount> chunkRelative;
+    };
+
+    [[noreturn]] void ThrowParseError(const std::string& reason)
+    {
+        throw std::runtime_error("Failed to read .obj file, reason:\n" + reason);
+    }
+
+    bool IsBlank(const char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    void SkipBlanks(const char*& cur, const char* end)
+    {
+        while (cur != end && IsBlank(*cur))
+        {
+            ++cur;
+        }
+    }
+
+    // Missing trailing components default to zero, as in tinyobjloader.
+    float_t ParseFloat(const char*& cur, const char* end)
+    {
+        SkipBlanks(cur, end);
+        if (cur == end)
+            return 0.f;
+
+        if (*cur == '+')
+            ++cur;
+
+        double value = 0.0;
+        const auto[ptr, ec] = std::from_chars(cur, end, value);
+        if (ec != std::errc{})
+            ThrowParseError("invalid number");
+
+        cur = ptr;
+        return static_cast<float_t>(value);
+    }
+
+    // Returns the index as written in the file, 0 when it is absent.
+    int64_t ParseRawIndex(const char*& cur, const char* end)
+    {
+        bool negative = false;
+        if (cur != end && (*cur == '-' || *cur == '+'))
+        {
+            negative = *cur == '-';
+            ++cur;
+        }
+
+        int64_t value = 0;
+        while (cur != end && *cur >= '0' && *cur <= '9')
+        {
+            value = value * 10 + (*cur - '0');
+            if (value > std::numeric_limits<uint32_t>::max())
+                ThrowParseError("invalid face index");
+            ++cur;
+        }
+        return negative ? -value : value;
+    }
+
+    void PushIndex(ChunkData& chunk, const Attribute attribute, const int64_t raw, const size_t chunk_count)
+    {
+        auto& indices = chunk.indices[attribute];
+        if (raw > 0)
+        {
+            indices.push_back(raw - 1);
+        }
+        else if (raw < 0)
+        {
+            chunk.chunkRelative[attribute].push_back(indices.size());
+            indices.push_back(static_cast<int64_t>(chunk_count) + raw);
+        }
+        else
+        {
+            indices.push_back(missing_index);
+        }
+    }
+
+    void ParseFace(const char* cur, const char* end, ChunkData& chunk)
+    {
+        size_t vertex_count = 0;
+        SkipBlanks(cur, end);
+        while (cur != end)
+        {
+            const auto position = ParseRawIndex(cur, end);
+            int64_t texture = 0;
+            int64_t normal = 0;
+            if (cur != end && *cur == '/')
+            {
+                ++cur;
+                texture = ParseRawIndex(cur, end);
+                if (cur != end && *cur == '/')
+                {
+                    ++cur;
+                    normal = ParseRawIndex(cur, end);
+                }
+            }
+
+            if (position == 0 || (cur != end && !IsBlank(*cur)))
+                ThrowParseError("invalid face index");
+
+            if (++vertex_count > 3)
+                throw std::runtime_error("Obj file not triangulated, aborting...");
+
+            PushIndex(chunk, Position, position, chunk.positions.size());
+            PushIndex(chunk, Texture, texture, chunk.textureCoords.size());
+            PushIndex(chunk, Normal, normal, chunk.normals.size());
+            SkipBlanks(cur, end);
+        }
+
+        if (vertex_count != 3)
+            throw std::runtime_error("Obj file not triangulated, aborting...");
+    }
+
+    void ParseChunk(const char* cur, const char* end, ChunkData& chunk)
+    {
+        const auto starts_with = [](const char* line, const char* line_end, const char* keyword) {
+            const auto length = std::strlen(keyword);
+            return static_cast<size_t>(line_end - line) > length
+                && std::memcmp(line, keyword, length) == 0
+                && IsBlank(line[length]);
+        };
+
+        while (cur < end)
+        {
+            auto line_end = static_cast<const char*>(std::memchr(cur, '\n', end - cur));
+            if (!line_end)
+                line_end = end;
+
+            SkipBlanks(cur, line_end);
+            if (starts_with(cur, line_end, "v"))
+            {
+                cur += 2;
+                const auto x = ParseFloat(cur, line_end);
+                const auto y = ParseFloat(cur, line_end);
+                const auto z = ParseFloat(cur, line_end);
+                chunk.positions.push_back(vec3f{ x, y, z });
+            }
+            else if (starts_with(cur, line_end, "vt"))
+            {
+                cur += 3;
+                const auto u = ParseFloat(cur, line_end);
+                const auto v = ParseFloat(cur, line_end);
+                chunk.textureCoords.push_back(vec2f{ u, v });
+            }
+            else if (starts_with(cur, line_end, "vn"))
+            {
+                cur += 3;
+                const auto x = ParseFloat(cur, line_end);
+                const auto y = ParseFloat(cur, line_end);
+                const auto z = ParseFloat(cur, line_end);
+                chunk.normals.push_back(vec3f{ x, y, z });
+            }
+            else if (starts_with(cur, line_end, "f"))
+            {
+                ParseFace(cur + 2, line_end, chunk);
+            }
+
+            cur = line_end + 1;
+        }
+    }
+}
+
+Mesh ParseObj(const char* data, const size_t size, const size_t chunk_count)
+{
+    const auto end = data + size;
+    const auto chunks_nr = std::max<size_t>(chunk_count, 1);
+
+    // Chunks start right after a newline, so no line is split between two.
+    std::vector<const char*> bounds(chunks_nr + 1, end);
+    bounds[0] = data;
+    for (size_t i = 1; i < chunks_nr; ++i)
+    {
+        const auto split = std::max(data + size * i / chunks_nr, bounds[i - 1]);
+        const auto newline = static_cast<const char*>(std::memchr(split, '\n', end - split));
+        bounds[i] = newline ? newline + 1 : end;
+    }
+
+    std::vector<ChunkData> chunks(chunks_nr);
+    std::vector<std::exception_ptr> errors(chunks_nr);
+    const auto parse = [&](const size_t i) {
+        try
+        {
+            ParseChunk(bounds[i], bounds[i + 1], chunks[i]);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks_nr; ++i)
+    {
+        workers.emplace_back(parse, i);
+    }
+    parse(0);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    for (const auto& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    Mesh mesh;
+    std::array<std::vector<int64_t>, AttributeCount> offsets;
+    for (auto& chunk : chunks)
+    {
+        offsets[Position].push_back(static_cast<int64_t>(mesh.positions.size()));
+        offsets[Texture].push_back(static_cast<int64_t>(mesh.textureCoords.size()));
+        offsets[Normal].push_back(static_cast<int64_t>(mesh.normals.size()));
+        mesh.positions.insert(mesh.positions.end(), chunk.positions.begin(), chunk.positions.end());
+        mesh.textureCoords.insert(mesh.textureCoords.end(), chunk.textureCoords.begin(), chunk.textureCoords.end());
+        mesh.normals.insert(mesh.normals.end(), chunk.normals.begin(), chunk.normals.end());
+        chunk.positions = {};
+        chunk.textureCoords = {};
+        chunk.normals = {};
+    }
+
+    // Face vertices without texture coordinates or normals point at one
+    // extra zero entry, matching the tinyobjloader based Obj.
+    const std::array<size_t, AttributeCount> counts = {
+        mesh.positions.size(), mesh.textureCoords.size(), mesh.normals.size() };
+    std::array<bool, AttributeCount> has_missing = { false, false, false };
+    std::array<std::vector<uint32_t>*, AttributeCount> outputs = {
+        &mesh.positionIndices, &mesh.textureIndices, &mesh.normalIndices };
+
+    for (size_t attribute = 0; attribute < AttributeCount; ++attribute)
+    {
+        auto& output = *outputs[attribute];
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            auto& indices = chunks[c].indices[attribute];
+            for (const auto slot : chunks[c].chunkRelative[attribute])
+            {
+                indices[slot] += offsets[attribute][c];
+            }
+
+            output.reserve(output.size() + indices.size());
+            for (const auto index : indices)
+            {
+                if (index == missing_index)
+                {
+                    output.push_back(static_cast<uint32_t>(counts[attribute]));
+                    has_missing[attribute] = true;
+                }
+                else if (index < 0 || static_cast<size_t>(index) >= counts[attribute])
+                {
+                    ThrowParseError("face index out of range");
+                }
+                else
+                {
+                    output.push_back(static_cast<uint32_t>(index));
+                }
+            }
+            indices = {};
+        }
+    }
+
+    if (has_missing[Texture])
+        mesh.textureCoords.push_back(vec2f{ 0.f, 0.f });
+    if (has_missing[Normal])
+        mesh.normals.push_back(vec3f{ 0.f, 0.f, 0.f });
+
+    return mesh;
+}
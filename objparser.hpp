@@ -0,0 +1,8 @@
+#pragma once
+
+#include "model.hpp"
+
+// Parses triangulated Wavefront OBJ text (v, vt, vn and f records) into a
+// flattened mesh. The text is split into chunk_count line-aligned chunks
+// that are parsed concurrently and merged in file order.
+Mesh ParseObj(const char* data, const size_t size, const size_t chunk_count);
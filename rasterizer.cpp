@@ -0,0 +1,105 @@
+#include "rasterizer.hpp"
+#include "rasterizer_simd.hpp"
+
+#if RASTERIZER_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+SimdLevel DetectSimdLevel()
+{
+#if RASTERIZER_X86
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    const auto max_leaf = regs[0];
+    __cpuid(regs, 1);
+    const bool sse2 = (regs[3] & (1 << 26)) != 0;
+    const bool os_saves_ymm = (regs[2] & (1 << 27)) != 0 && (regs[2] & (1 << 28)) != 0
+        && (_xgetbv(0) & 0x6) == 0x6;
+    bool avx2 = false;
+    if (max_leaf >= 7 && os_saves_ymm)
+    {
+        __cpuidex(regs, 7, 0);
+        avx2 = (regs[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    const bool sse2 = __builtin_cpu_supports("sse2");
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2)
+        return SimdLevel::Avx2;
+    if (sse2)
+        return SimdLevel::Sse2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+std::optional<TriangleSetup> SetupTriangle(const Triangle& triangle)
+{
+    const auto to_fixed = [](const float_t v) {
+        return static_cast<int64_t>(std::llround(v * (1 << subpixel_bits)));
+    };
+
+    std::array<int64_t, 3> xs;
+    std::array<int64_t, 3> ys;
+    for (size_t i = 0; i < triangle.size(); ++i)
+    {
+        xs[i] = to_fixed(get_x(triangle[i]));
+        ys[i] = to_fixed(get_y(triangle[i]));
+    }
+
+    TriangleSetup setup;
+    setup.z = { get_z(triangle[0]), get_z(triangle[1]), get_z(triangle[2]) };
+
+    // Edge i is opposite to vertex i, so its value is proportional to the
+    // barycentric weight of that vertex.
+    const auto make_edge = [&xs, &ys](const size_t from, const size_t to) {
+        const auto a = ys[from] - ys[to];
+        const auto b = xs[to] - xs[from];
+        return EdgeEquation{ a, b, -a * xs[from] - b * ys[from] };
+    };
+
+    setup.edges = { make_edge(1, 2), make_edge(2, 0), make_edge(0, 1) };
+
+    auto area = setup.edges[0].a * xs[0] + setup.edges[0].b * ys[0] + setup.edges[0].c;
+    if (area == 0)
+        return std::nullopt;
+
+    if (area < 0)
+    {
+        for (auto& edge : setup.edges)
+        {
+            edge = { -edge.a, -edge.b, -edge.c };
+        }
+        area = -area;
+    }
+
+    setup.originX = static_cast<int32_t>(xs[0] >> subpixel_bits);
+    setup.originY = static_cast<int32_t>(ys[0] >> subpixel_bits);
+
+    const auto origin_x = int64_t{ setup.originX } << subpixel_bits;
+    const auto origin_y = int64_t{ setup.originY } << subpixel_bits;
+    const auto pixel_step = static_cast<double>(1 << subpixel_bits) / static_cast<double>(area);
+    for (size_t i = 0; i < setup.edges.size(); ++i)
+    {
+        auto& edge = setup.edges[i];
+        const auto at_origin = edge.a * origin_x + edge.b * origin_y + edge.c;
+        setup.barycentric[i] = {
+            static_cast<float_t>(edge.a * pixel_step),
+            static_cast<float_t>(edge.b * pixel_step),
+            static_cast<float_t>(static_cast<double>(at_origin) / area) };
+
+        const auto is_top_left = edge.a > 0 || (edge.a == 0 && edge.b > 0);
+        if (!is_top_left)
+            edge.c -= 1;
+    }
+
+    const auto pixel_unit = int64_t{ 1 } << subpixel_bits;
+    setup.minX = static_cast<int32_t>((*std::min_element(xs.begin(), xs.end()) + pixel_unit - 1) >> subpixel_bits);
+    setup.minY = static_cast<int32_t>((*std::min_element(ys.begin(), ys.end()) + pixel_unit - 1) >> subpixel_bits);
+    setup.maxX = static_cast<int32_t>(*std::max_element(xs.begin(), xs.end()) >> subpixel_bits);
+    setup.maxY = static_cast<int32_t>(*std::max_element(ys.begin(), ys.end()) >> subpixel_bits);
+
+    return setup;
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include "depthformat.hpp"
+#include "hola/hola.hpp"
+
+using namespace hola;
+
+using Triangle = std::array<vec3f, 3>;
+
+struct BoundingBox
+{
+    vec2f min;
+    vec2f max;
+};
+
+constexpr int32_t subpixel_bits = 8;
+
+// E(X, Y) = a*X + b*Y + c in fixed point screen coordinates. Top-left fill
+// rule bias is already folded into c, so a sample is covered when E >= 0.
+struct EdgeEquation
+{
+    int64_t a;
+    int64_t b;
+    int64_t c;
+};
+
+// Barycentric weight of a vertex as a plane relative to the setup origin,
+// evaluated per row and then per pixel so every traversal order produces
+// bit-identical weights for the same pixel.
+struct BarycentricPlane
+{
+    float_t dx;
+    float_t dy;
+    float_t c;
+};
+
+struct TriangleSetup
+{
+    std::array<EdgeEquation, 3> edges;
+    std::array<BarycentricPlane, 3> barycentric;
+    std::array<float_t, 3> z;
+    int32_t originX;
+    int32_t originY;
+    int32_t minX;
+    int32_t minY;
+    int32_t maxX;
+    int32_t maxY;
+};
+
+struct PixelRegion
+{
+    int32_t minX;
+    int32_t minY;
+    int32_t maxX;
+    int32_t maxY;
+};
+
+// Pixels a kernel found inside the triangle and how many of them passed the
+// depth test.
+struct FragmentCount
+{
+    uint64_t covered = 0;
+    uint64_t passed = 0;
+
+    FragmentCount& operator+=(const FragmentCount& other)
+    {
+        covered += other.covered;
+        passed += other.passed;
+        return *this;
+    }
+};
+
+// Edge values and barycentric row terms at the first pixel of a scanline.
+struct ScanlineStart
+{
+    std::array<int64_t, 3> w;
+    std::array<float_t, 3> row;
+};
+
+enum class SimdLevel
+{
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+SimdLevel DetectSimdLevel();
+std::optional<TriangleSetup> SetupTriangle(const Triangle& triangle);
+
+inline std::optional<PixelRegion> ClipRegion(const TriangleSetup& setup, const BoundingBox& clip)
+{
+    const PixelRegion region{
+        std::max(setup.minX, static_cast<int32_t>(std::ceil(get_x(clip.min)))),
+        std::max(setup.minY, static_cast<int32_t>(std::ceil(get_y(clip.min)))),
+        std::min(setup.maxX, static_cast<int32_t>(std::floor(get_x(clip.max)))),
+        std::min(setup.maxY, static_cast<int32_t>(std::floor(get_y(clip.max)))) };
+
+    if (region.minX > region.maxX || region.minY > region.maxY)
+        return std::nullopt;
+
+    return region;
+}
+
+inline int64_t EdgeStepX(const EdgeEquation& edge)
+{
+    return edge.a * (int64_t{ 1 } << subpixel_bits);
+}
+
+inline ScanlineStart StartScanline(const TriangleSetup& setup, const int32_t x, const int32_t y)
+{
+    const int64_t fixed_x = int64_t{ x } << subpixel_bits;
+    const int64_t fixed_y = int64_t{ y } << subpixel_bits;
+    const auto fy = static_cast<float_t>(y - setup.originY);
+
+    ScanlineStart scanline;
+    for (size_t i = 0; i < setup.edges.size(); ++i)
+    {
+        const auto& edge = setup.edges[i];
+        scanline.w[i] = edge.a * fixed_x + edge.b * fixed_y + edge.c;
+        scanline.row[i] = setup.barycentric[i].c + fy * setup.barycentric[i].dy;
+    }
+    return scanline;
+}
+
+inline vec3f PixelBarycentric(const TriangleSetup& setup, const ScanlineStart& scanline, const int32_t x)
+{
+    const auto fx = static_cast<float_t>(x - setup.originX);
+    return vec3f{
+        scanline.row[0] + fx * setup.barycentric[0].dx,
+        scanline.row[1] + fx * setup.barycentric[1].dx,
+        scanline.row[2] + fx * setup.barycentric[2].dx };
+}
+
+inline float_t InterpolateDepth(const TriangleSetup& setup, const vec3f& barycentric)
+{
+    return setup.z[0] * barycentric[0] + setup.z[1] * barycentric[1] + setup.z[2] * barycentric[2];
+}
+
+// Upper bound of the depth InterpolateDepth gives any pixel the triangle
+// covers, for HiZ tests. Each barycentric weight sums its plane's terms, which
+// grow with the distance from the setup origin and may be far larger than
+// the weight itself on long slivers; the margin is a few roundings of the
+// largest of those sums over the triangle's bounds, weighted by the depths.
+inline float_t DepthBound(const TriangleSetup& setup)
+{
+    const auto span_x = static_cast<float_t>(std::max(std::abs(setup.minX - setup.originX), std::abs(setup.maxX - setup.originX)));
+    const auto span_y = static_cast<float_t>(std::max(std::abs(setup.minY - setup.originY), std::abs(setup.maxY - setup.originY)));
+    float_t terms = 0.f;
+    for (size_t i = 0; i < setup.z.size(); ++i)
+    {
+        const auto& plane = setup.barycentric[i];
+        terms += std::abs(setup.z[i])
+            * (1.f + std::abs(plane.c) + std::abs(plane.dx) * span_x + std::abs(plane.dy) * span_y);
+    }
+    return *std::max_element(setup.z.begin(), setup.z.end())
+        + 8.f * std::numeric_limits<float_t>::epsilon() * terms;
+}
+
+template <typename FragmentFunc>
+void Rasterize(const TriangleSetup& setup, const BoundingBox& clip, FragmentFunc&& fragment)
+{
+    const auto region = ClipRegion(setup, clip);
+    if (!region)
+        return;
+
+    const auto step_x0 = EdgeStepX(setup.edges[0]);
+    const auto step_x1 = EdgeStepX(setup.edges[1]);
+    const auto step_x2 = EdgeStepX(setup.edges[2]);
+    for (auto y = region->minY; y <= region->maxY; ++y)
+    {
+        const auto scanline = StartScanline(setup, region->minX, y);
+        auto[w0, w1, w2] = scanline.w;
+        for (auto x = region->minX; x <= region->maxX; ++x)
+        {
+            if ((w0 | w1 | w2) >= 0)
+                fragment(x, y, PixelBarycentric(setup, scanline, x));
+
+            w0 += step_x0;
+            w1 += step_x1;
+            w2 += step_x2;
+        }
+    }
+}
+
+// Depth tests [from_x, to_x] of one scanline, whose depth starts at depth
+// (the pixel at from_x), and shades every fragment that passes.
+template <typename Format, typename ShadeFunc>
+FragmentCount DepthTestSpan(const TriangleSetup& setup,
+    const ScanlineStart& scanline,
+    const int32_t y,
+    const int32_t from_x,
+    const int32_t to_x,
+    typename Format::Storage* depth,
+    ShadeFunc& shade)
+{
+    const auto step_x0 = EdgeStepX(setup.edges[0]);
+    const auto step_x1 = EdgeStepX(setup.edges[1]);
+    const auto step_x2 = EdgeStepX(setup.edges[2]);
+    auto[w0, w1, w2] = scanline.w;
+    FragmentCount count;
+    for (auto x = from_x; x <= to_x; ++x, depth += Format::elements_per_pixel)
+    {
+        if ((w0 | w1 | w2) >= 0)
+        {
+            ++count.covered;
+            const auto barycentric = PixelBarycentric(setup, scanline, x);
+            const auto z = Format::Encode(InterpolateDepth(setup, barycentric));
+            if (Format::Load(depth) < z)
+            {
+                Format::Store(depth, z);
+                ++count.passed;
+                shade(x, y, barycentric);
+            }
+        }
+
+        w0 += step_x0;
+        w1 += step_x1;
+        w2 += step_x2;
+    }
+    return count;
+}
+
+template <typename Format, typename ShadeFunc>
+FragmentCount RasterizeDepthTestedScalar(const TriangleSetup& setup,
+    const BoundingBox& clip,
+    const DepthView<Format>& depth,
+    ShadeFunc&& shade)
+{
+    const auto region = ClipRegion(setup, clip);
+    if (!region)
+        return {};
+
+    FragmentCount count;
+    for (auto y = region->minY; y <= region->maxY; ++y)
+    {
+        count += DepthTestSpan<Format>(setup, StartScanline(setup, region->minX, y), y,
+            region->minX, region->maxX, depth.Pixel(region->minX, y), shade);
+    }
+    return count;
+}
@@ -0,0 +1,395 @@
+#pragma once
+
+#include "rasterizer.hpp"
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RASTERIZER_X86 1
+#include <immintrin.h>
+#else
+#define RASTERIZER_X86 0
+#endif
+
+// MSVC allows intrinsics in any function, GCC and Clang need the instruction
+// set enabled per function so one binary can run on every x86 node.
+#if defined(__GNUC__) || defined(__clang__)
+#define RASTERIZER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RASTERIZER_TARGET(isa)
+#endif
+
+#if RASTERIZER_X86
+
+// Set bits of a lane mask. A table, since SSE2 and AVX2 targets can't rely on
+// POPCNT and the generic fallback is a library call per block.
+inline uint64_t LaneCount(const int mask)
+{
+    static constexpr auto counts = [] {
+        std::array<uint8_t, 256> table{};
+        for (size_t i = 1; i < table.size(); ++i)
+        {
+            table[i] = static_cast<uint8_t>(table[i >> 1] + (i & 1));
+        }
+        return table;
+    }();
+    return counts[static_cast<size_t>(mask) & 0xFF];
+}
+
+// Depth tests the covered ones of 4 pixels starting at depth and stores the
+// codes of those that pass; returns their lane mask. Float depth and 16-bit
+// codes are tested in registers, 24-bit ones lane by lane.
+template <typename Format>
+RASTERIZER_TARGET("sse2")
+inline int DepthTestLanesSse2(typename Format::Storage* depth, const __m128 z, const __m128 covered)
+{
+    if constexpr (std::is_same_v<Format, Float32Depth>)
+    {
+        const auto old_z = _mm_loadu_ps(depth);
+        const auto pass = _mm_and_ps(_mm_cmplt_ps(old_z, z), covered);
+        const auto pass_bits = _mm_movemask_ps(pass);
+        if (pass_bits != 0)
+            _mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old_z)));
+        return pass_bits;
+    }
+    else if constexpr (std::is_same_v<Format, Unorm16Depth>)
+    {
+        const auto one = _mm_set1_ps(1.f);
+        const auto scaled = _mm_add_ps(_mm_mul_ps(_mm_add_ps(z, one), _mm_set1_ps(Format::half_range)), one);
+        const auto code = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(scaled, one), _mm_set1_ps(Format::max_code)));
+        const auto old_code = _mm_unpacklo_epi16(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(depth)), _mm_setzero_si128());
+        const auto pass = _mm_and_si128(_mm_cmplt_epi32(old_code, code), _mm_castps_si128(covered));
+        const auto pass_bits = _mm_movemask_ps(_mm_castsi128_ps(pass));
+        if (pass_bits != 0)
+        {
+            // SSE2 only packs signed, so codes are shifted into int16 range and back.
+            const auto merged = _mm_sub_epi32(
+                _mm_or_si128(_mm_and_si128(pass, code), _mm_andnot_si128(pass, old_code)), _mm_set1_epi32(0x8000));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(depth),
+                _mm_xor_si128(_mm_packs_epi32(merged, merged), _mm_set1_epi16(-0x8000)));
+        }
+        return pass_bits;
+    }
+    else
+    {
+        alignas(16) float_t lane_z[4];
+        _mm_store_ps(lane_z, z);
+        const auto covered_bits = _mm_movemask_ps(covered);
+        auto pass_bits = 0;
+        for (int32_t lane = 0; lane < 4; ++lane, depth += Format::elements_per_pixel)
+        {
+            if (!(covered_bits & (1 << lane)))
+                continue;
+
+            const auto code = Format::Encode(lane_z[lane]);
+            if (Format::Load(depth) < code)
+            {
+                Format::Store(depth, code);
+                pass_bits |= 1 << lane;
+            }
+        }
+        return pass_bits;
+    }
+}
+
+// 8-pixel variant of DepthTestLanesSse2.
+template <typename Format>
+RASTERIZER_TARGET("avx2")
+inline int DepthTestLanesAvx2(typename Format::Storage* depth, const __m256 z, const __m256 covered)
+{
+    if constexpr (std::is_same_v<Format, Float32Depth>)
+    {
+        const auto old_z = _mm256_loadu_ps(depth);
+        const auto pass = _mm256_and_ps(_mm256_cmp_ps(old_z, z, _CMP_LT_OQ), covered);
+        const auto pass_bits = _mm256_movemask_ps(pass);
+        if (pass_bits != 0)
+            _mm256_maskstore_ps(depth, _mm256_castps_si256(pass), z);
+        return pass_bits;
+    }
+    else if constexpr (std::is_same_v<Format, Unorm16Depth>)
+    {
+        const auto one = _mm256_set1_ps(1.f);
+        const auto scaled = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(z, one), _mm256_set1_ps(Format::half_range)), one);
+        const auto code = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(scaled, one), _mm256_set1_ps(Format::max_code)));
+        const auto old_code = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth)));
+        const auto pass = _mm256_and_si256(_mm256_cmpgt_epi32(code, old_code), _mm256_castps_si256(covered));
+        const auto pass_bits = _mm256_movemask_ps(_mm256_castsi256_ps(pass));
+        if (pass_bits != 0)
+        {
+            const auto merged = _mm256_blendv_epi8(old_code, code, pass);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(depth),
+                _mm_packus_epi32(_mm256_castsi256_si128(merged), _mm256_extracti128_si256(merged, 1)));
+        }
+        return pass_bits;
+    }
+    else
+    {
+        alignas(32) float_t lane_z[8];
+        _mm256_store_ps(lane_z, z);
+        const auto covered_bits = _mm256_movemask_ps(covered);
+        auto pass_bits = 0;
+        for (int32_t lane = 0; lane < 8; ++lane, depth += Format::elements_per_pixel)
+        {
+            if (!(covered_bits & (1 << lane)))
+                continue;
+
+            const auto code = Format::Encode(lane_z[lane]);
+            if (Format::Load(depth) < code)
+            {
+                Format::Store(depth, code);
+                pass_bits |= 1 << lane;
+            }
+        }
+        return pass_bits;
+    }
+}
+
+// Same per-pixel math as DepthTestSpan evaluated on 4 pixels at once. Edge
+// values stay exact 64-bit integers and barycentrics are computed with the
+// same float operations, so the output matches the scalar path bit for bit.
+template <typename Format, typename ShadeFunc>
+RASTERIZER_TARGET("sse2")
+FragmentCount RasterizeDepthTestedSse2(const TriangleSetup& setup,
+    const BoundingBox& clip,
+    const DepthView<Format>& depth_view,
+    ShadeFunc&& shade)
+{
+    constexpr int32_t lanes = 4;
+    const auto region = ClipRegion(setup, clip);
+    if (!region)
+        return {};
+
+    __m128i offsets_lo[3];
+    __m128i offsets_hi[3];
+    __m128i block_step[3];
+    __m128 bary_dx[3];
+    __m128 depth[3];
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const auto step = EdgeStepX(setup.edges[i]);
+        offsets_lo[i] = _mm_set_epi64x(step, 0);
+        offsets_hi[i] = _mm_set_epi64x(3 * step, 2 * step);
+        block_step[i] = _mm_set1_epi64x(lanes * step);
+        bary_dx[i] = _mm_set1_ps(setup.barycentric[i].dx);
+        depth[i] = _mm_set1_ps(setup.z[i]);
+    }
+    const __m128i lane_index = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+
+    FragmentCount count;
+    for (auto y = region->minY; y <= region->maxY; ++y)
+    {
+        auto scanline = StartScanline(setup, region->minX, y);
+        auto depth_pixel = depth_view.Pixel(region->minX, y);
+
+        __m128i w_lo[3];
+        __m128i w_hi[3];
+        __m128 row[3];
+        for (size_t i = 0; i < 3; ++i)
+        {
+            w_lo[i] = _mm_add_epi64(_mm_set1_epi64x(scanline.w[i]), offsets_lo[i]);
+            w_hi[i] = _mm_add_epi64(_mm_set1_epi64x(scanline.w[i]), offsets_hi[i]);
+            row[i] = _mm_set1_ps(scanline.row[i]);
+        }
+
+        auto x = region->minX;
+        for (; x + lanes - 1 <= region->maxX; x += lanes)
+        {
+            const auto any_lo = _mm_or_si128(_mm_or_si128(w_lo[0], w_lo[1]), w_lo[2]);
+            const auto any_hi = _mm_or_si128(_mm_or_si128(w_hi[0], w_hi[1]), w_hi[2]);
+            const auto outside =
+                _mm_movemask_pd(_mm_castsi128_pd(any_lo)) |
+                (_mm_movemask_pd(_mm_castsi128_pd(any_hi)) << 2);
+
+            if (outside != 0xF)
+            {
+                count.covered += LaneCount(~outside & 0xF);
+                const auto covered_bits = _mm_set1_epi32(~outside & 0xF);
+                const auto covered = _mm_castsi128_ps(
+                    _mm_cmpeq_epi32(_mm_and_si128(covered_bits, lane_bits), lane_bits));
+
+                const auto fx = _mm_cvtepi32_ps(
+                    _mm_add_epi32(_mm_set1_epi32(x - setup.originX), lane_index));
+                const auto b0 = _mm_add_ps(row[0], _mm_mul_ps(fx, bary_dx[0]));
+                const auto b1 = _mm_add_ps(row[1], _mm_mul_ps(fx, bary_dx[1]));
+                const auto b2 = _mm_add_ps(row[2], _mm_mul_ps(fx, bary_dx[2]));
+                const auto z = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(depth[0], b0), _mm_mul_ps(depth[1], b1)),
+                    _mm_mul_ps(depth[2], b2));
+
+                const auto pass_bits = DepthTestLanesSse2<Format>(depth_pixel, z, covered);
+                if (pass_bits != 0)
+                {
+                    count.passed += LaneCount(pass_bits);
+
+                    alignas(16) float_t lane_b0[lanes];
+                    alignas(16) float_t lane_b1[lanes];
+                    alignas(16) float_t lane_b2[lanes];
+                    _mm_store_ps(lane_b0, b0);
+                    _mm_store_ps(lane_b1, b1);
+                    _mm_store_ps(lane_b2, b2);
+                    for (int32_t lane = 0; lane < lanes; ++lane)
+                    {
+                        if (pass_bits & (1 << lane))
+                            shade(x + lane, y, vec3f{ lane_b0[lane], lane_b1[lane], lane_b2[lane] });
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < 3; ++i)
+            {
+                w_lo[i] = _mm_add_epi64(w_lo[i], block_step[i]);
+                w_hi[i] = _mm_add_epi64(w_hi[i], block_step[i]);
+            }
+            depth_pixel += lanes * Format::elements_per_pixel;
+        }
+
+        if (x <= region->maxX)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                scanline.w[i] += (x - region->minX) * EdgeStepX(setup.edges[i]);
+            }
+            count += DepthTestSpan<Format>(setup, scanline, y, x, region->maxX, depth_pixel, shade);
+        }
+    }
+    return count;
+}
+
+// 8-pixel variant of RasterizeDepthTestedSse2.
+template <typename Format, typename ShadeFunc>
+RASTERIZER_TARGET("avx2")
+FragmentCount RasterizeDepthTestedAvx2(const TriangleSetup& setup,
+    const BoundingBox& clip,
+    const DepthView<Format>& depth_view,
+    ShadeFunc&& shade)
+{
+    constexpr int32_t lanes = 8;
+    const auto region = ClipRegion(setup, clip);
+    if (!region)
+        return {};
+
+    __m256i offsets_lo[3];
+    __m256i offsets_hi[3];
+    __m256i block_step[3];
+    __m256 bary_dx[3];
+    __m256 depth[3];
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const auto step = EdgeStepX(setup.edges[i]);
+        offsets_lo[i] = _mm256_setr_epi64x(0, step, 2 * step, 3 * step);
+        offsets_hi[i] = _mm256_setr_epi64x(4 * step, 5 * step, 6 * step, 7 * step);
+        block_step[i] = _mm256_set1_epi64x(lanes * step);
+        bary_dx[i] = _mm256_set1_ps(setup.barycentric[i].dx);
+        depth[i] = _mm256_set1_ps(setup.z[i]);
+    }
+    const __m256i lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+    FragmentCount count;
+    for (auto y = region->minY; y <= region->maxY; ++y)
+    {
+        auto scanline = StartScanline(setup, region->minX, y);
+        auto depth_pixel = depth_view.Pixel(region->minX, y);
+
+        __m256i w_lo[3];
+        __m256i w_hi[3];
+        __m256 row[3];
+        for (size_t i = 0; i < 3; ++i)
+        {
+            w_lo[i] = _mm256_add_epi64(_mm256_set1_epi64x(scanline.w[i]), offsets_lo[i]);
+            w_hi[i] = _mm256_add_epi64(_mm256_set1_epi64x(scanline.w[i]), offsets_hi[i]);
+            row[i] = _mm256_set1_ps(scanline.row[i]);
+        }
+
+        auto x = region->minX;
+        for (; x + lanes - 1 <= region->maxX; x += lanes)
+        {
+            const auto any_lo = _mm256_or_si256(_mm256_or_si256(w_lo[0], w_lo[1]), w_lo[2]);
+            const auto any_hi = _mm256_or_si256(_mm256_or_si256(w_hi[0], w_hi[1]), w_hi[2]);
+            const auto outside =
+                _mm256_movemask_pd(_mm256_castsi256_pd(any_lo)) |
+                (_mm256_movemask_pd(_mm256_castsi256_pd(any_hi)) << 4);
+
+            if (outside != 0xFF)
+            {
+                count.covered += LaneCount(~outside & 0xFF);
+                const auto covered_bits = _mm256_set1_epi32(~outside & 0xFF);
+                const auto covered = _mm256_castsi256_ps(
+                    _mm256_cmpeq_epi32(_mm256_and_si256(covered_bits, lane_bits), lane_bits));
+
+                const auto fx = _mm256_cvtepi32_ps(
+                    _mm256_add_epi32(_mm256_set1_epi32(x - setup.originX), lane_index));
+                const auto b0 = _mm256_add_ps(row[0], _mm256_mul_ps(fx, bary_dx[0]));
+                const auto b1 = _mm256_add_ps(row[1], _mm256_mul_ps(fx, bary_dx[1]));
+                const auto b2 = _mm256_add_ps(row[2], _mm256_mul_ps(fx, bary_dx[2]));
+                const auto z = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(depth[0], b0), _mm256_mul_ps(depth[1], b1)),
+                    _mm256_mul_ps(depth[2], b2));
+
+                const auto pass_bits = DepthTestLanesAvx2<Format>(depth_pixel, z, covered);
+                if (pass_bits != 0)
+                {
+                    count.passed += LaneCount(pass_bits);
+
+                    alignas(32) float_t lane_b0[lanes];
+                    alignas(32) float_t lane_b1[lanes];
+                    alignas(32) float_t lane_b2[lanes];
+                    _mm256_store_ps(lane_b0, b0);
+                    _mm256_store_ps(lane_b1, b1);
+                    _mm256_store_ps(lane_b2, b2);
+                    // shade may be legacy SSE code that isn't inlined here;
+                    // dirty upper halves would make every call pay a
+                    // transition penalty.
+                    _mm256_zeroupper();
+                    for (int32_t lane = 0; lane < lanes; ++lane)
+                    {
+                        if (pass_bits & (1 << lane))
+                            shade(x + lane, y, vec3f{ lane_b0[lane], lane_b1[lane], lane_b2[lane] });
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < 3; ++i)
+            {
+                w_lo[i] = _mm256_add_epi64(w_lo[i], block_step[i]);
+                w_hi[i] = _mm256_add_epi64(w_hi[i], block_step[i]);
+            }
+            depth_pixel += lanes * Format::elements_per_pixel;
+        }
+
+        if (x <= region->maxX)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                scanline.w[i] += (x - region->minX) * EdgeStepX(setup.edges[i]);
+            }
+            // Same as above: the scalar tail may not be inlined.
+            _mm256_zeroupper();
+            count += DepthTestSpan<Format>(setup, scanline, y, x, region->maxX, depth_pixel, shade);
+        }
+    }
+    return count;
+}
+
+#endif
+
+template <typename Format, typename ShadeFunc>
+FragmentCount RasterizeDepthTested(const SimdLevel level,
+    const TriangleSetup& setup,
+    const BoundingBox& clip,
+    const DepthView<Format>& depth,
+    ShadeFunc&& shade)
+{
+    switch (level)
+    {
+#if RASTERIZER_X86
+    case SimdLevel::Avx2:
+        return RasterizeDepthTestedAvx2(setup, clip, depth, shade);
+    case SimdLevel::Sse2:
+        return RasterizeDepthTestedSse2(setup, clip, depth, shade);
+#endif
+    default:
+        return RasterizeDepthTestedScalar(setup, clip, depth, shade);
+    }
+}
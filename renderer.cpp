@@ -1,13 +1,134 @@
 #include "renderer.hpp"
+#include "culling.hpp"
+#include "shaders.hpp"
+#include "rasterizer_simd.hpp"
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <utility>
 
-float_t Renderer::CalculateLightIntensity(const Triangle& triangle)
+namespace
 {
-    const auto&[v0, v1, v2] = triangle;
-    const auto n = cross(v2 - v0, v1 - v0);
-    const auto normalized = normalize(n);
+    constexpr size_t tile_size = 64;
+    constexpr uint32_t no_triangle = std::numeric_limits<uint32_t>::max();
+
+    vec2i TexturePosition(const vec3f& barycentric,
+        const TexCoords& texture_coords,
+        const Width width,
+        const Height height)
+    {
+        const auto p_uv =
+            texture_coords[0] * barycentric[0] +
+            texture_coords[1] * barycentric[1] +
+            texture_coords[2] * barycentric[2];
+
+        return vec2i{
+            static_cast<int>(width - get_x(p_uv)*width),
+            static_cast<int>(height - get_y(p_uv)*height) };
+    }
+
+    // Samplers hand RenderTriangle a per-triangle texture lookup, so the
+    // choice of texture source is resolved at compile time.
+    struct ImageSampler
+    {
+        Renderer& renderer;
+        ConstPixelView texels;
+
+        auto ForTriangle(const ScreenTriangle& triangle) const
+        {
+            return [this, &triangle](const vec3f& barycentric) {
+                return renderer.GetColorFromTexture(barycentric, triangle.textureCoordinates, texels);
+            };
+        }
+    };
+
+    struct TextureSampler
+    {
+        const Texture& texture;
+
+        auto ForTriangle(const ScreenTriangle& triangle) const
+        {
+            const auto level = texture.SelectLevel(triangle.triangle, triangle.textureCoordinates);
+            return [this, &triangle, level](const vec3f& barycentric) {
+                return texture.Sample(barycentric, triangle.textureCoordinates, level);
+            };
+        }
+    };
+
+    BoundingBox FullImage(const PixelView& pixels)
+    {
+        return {
+            vec2f{ 0.f, 0.f },
+            vec2f{ static_cast<float>(pixels.width) - 1.f, static_cast<float>(pixels.height) - 1.f } };
+    }
+
+    BoundingBox RegionBox(const PixelRegion& region)
+    {
+        return {
+            vec2f{ static_cast<float>(region.minX), static_cast<float>(region.minY) },
+            vec2f{ static_cast<float>(region.maxX), static_cast<float>(region.maxY) } };
+    }
+
+    uint64_t RegionArea(const PixelRegion& region)
+    {
+        return static_cast<uint64_t>(region.maxX - region.minX + 1) * static_cast<uint64_t>(region.maxY - region.minY + 1);
+    }
 
-    return dot(m_lightVector, normalized);
+    void CountFragments(RenderStats& stats, const uint64_t tested, const FragmentCount& count)
+    {
+        stats.pixelsTested += tested;
+        stats.pixelsCovered += count.covered;
+        stats.depthPassed += count.passed;
+        stats.depthFailed += count.covered - count.passed;
+    }
+}
+
+HiZStats Renderer::GetHiZStats() const
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_hiZStats;
+}
+
+RenderStats Renderer::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
+
+void Renderer::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats = RenderStats{};
+}
+
+void Renderer::MergeStats(const RenderStats& stats)
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_hiZStats += stats.hiZ;
+    if (m_statsEnabled)
+        m_stats += stats;
+}
+
+void Renderer::ResetDepth(const ImageSize& size)
+{
+    const auto[width, height] = size;
+    m_depth.Reset(width, height);
+    m_activeDepth = &m_depth;
+}
+
+void Renderer::SetThreadCount(const uint32_t thread_count)
+{
+    m_threadCount = thread_count != 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency());
+    m_workers.Resize(m_threadCount);
+}
+
+float_t Renderer::CalculateLightIntensity(const Triangle& triangle)
+{
+    return FaceIntensity(triangle, m_lightVector);
 }
 
 BoundingBox Renderer::CalculateBoundingBox(const Triangle& triangle, const ImageSize& size)
@@ -50,49 +171,490 @@ std::optional<vec3f> Renderer::CalculateBarycentric(const Point& p, const Triang
 std::unique_ptr<IColor> Renderer::GetColorFromTexture(const vec3f & barycentric, const TexCoords & texture_coords, const IImg & texture)
 {
     const auto[width, height] = texture.GetImageSize();
-    const auto p_uv =
-        texture_coords[0] * barycentric[0] +
-        texture_coords[1] * barycentric[1] +
-        texture_coords[2] * barycentric[2];
+    const auto position = TexturePosition(barycentric, texture_coords, width, height);
+    return texture.GetPixelColor(get_x(position), get_y(position));
+}
 
-    const int tex_x = static_cast<int>(width - get_x(p_uv)*width);
-    const int tex_y = static_cast<int>(height - get_y(p_uv)*height);
-    return texture.GetPixelColor(tex_x, tex_y);
+RGBA Renderer::GetColorFromTexture(const vec3f& barycentric, const TexCoords& texture_coords, const ConstPixelView& texture)
+{
+    const auto position = TexturePosition(barycentric, texture_coords, texture.width, texture.height);
+    return texture.Get(get_x(position), get_y(position));
 }
 
 void Renderer::RenderModel(const IModel& model, IImg& texture, IImg& out_image)
 {
-    const auto[width, height] = out_image.GetImageSize();
-    const auto triangle_to_screen_coords =
-        [width, height](const auto&... v) -> Triangle {
+    ResetDepth(out_image.GetImageSize());
+    RenderShaded(SelectMesh(model, out_image.GetImageSize()), ImageSampler{ *this, std::as_const(texture).GetPixels() }, out_image.GetPixels(), m_depth);
+}
+
+void Renderer::RenderModel(const IModel& model, const Texture& texture, IImg& out_image)
+{
+    ResetDepth(out_image.GetImageSize());
+    RenderShaded(SelectMesh(model, out_image.GetImageSize()), TextureSampler{ texture }, out_image.GetPixels(), m_depth);
+}
+
+void Renderer::RenderModel(const IModel& model, IImg& texture, FrameBuffer& target)
+{
+    RenderShaded(SelectMesh(model, target.GetImageSize()), ImageSampler{ *this, std::as_const(texture).GetPixels() }, target.GetPixels(), target.Depth());
+}
+
+void Renderer::RenderModel(const IModel& model, const Texture& texture, FrameBuffer& target)
+{
+    RenderShaded(SelectMesh(model, target.GetImageSize()), TextureSampler{ texture }, target.GetPixels(), target.Depth());
+}
+
+void Renderer::RenderModelInBands(const IModel& model,
+    const Texture& texture,
+    const ImageSize& size,
+    const Height band_height,
+    FrameBuffer& band,
+    const BandWriter& write_band)
+{
+    WithShaders([&](const auto& vertex_shader, const auto& fragment_shader) {
+        RenderMeshInBands(SelectMesh(model, size), vertex_shader, fragment_shader, TextureSampler{ texture },
+            size, band_height, band, write_band);
+    });
+}
+
+template <typename MeshFunc>
+void Renderer::WithShaders(MeshFunc&& render_mesh)
+{
+    switch (m_shading)
+    {
+    case Shading::Flat:
+        render_mesh(FlatVertexShader{ m_lightVector }, FlatFragmentShader{});
+        break;
+    case Shading::Gouraud:
+        render_mesh(GouraudVertexShader{ m_lightVector }, GouraudFragmentShader{});
+        break;
+    case Shading::NormalMapped:
+        if (!m_normalMap)
+            throw std::runtime_error("Normal mapped shading needs a normal map");
+        render_mesh(UnlitVertexShader{}, NormalMappedFragmentShader{ *m_normalMap, m_lightVector });
+        break;
+    case Shading::DepthOnly:
+        render_mesh(UnlitVertexShader{}, DepthOnlyFragmentShader{});
+        break;
+    }
+}
+
+template <typename Sampler>
+void Renderer::RenderShaded(const MeshView& mesh, const Sampler& sampler, const PixelView& pixels, DepthBuffer& depth)
+{
+    WithShaders([&](const auto& vertex_shader, const auto& fragment_shader) {
+        RenderMesh(mesh, vertex_shader, fragment_shader, sampler, pixels, depth);
+    });
+}
+
+void Renderer::ResetHiZCounters()
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_hiZStats = HiZStats{};
+}
+
+template <typename VertexShader, typename SubmitFunc>
+void Renderer::CullMesh(const MeshView& mesh,
+    const VertexShader& vertex_shader,
+    const ImageSize& size,
+    RenderStats& stats,
+    SubmitFunc&& submit)
+{
+    const auto[width, height] = size;
+    const auto to_screen_coords = [width = width, height = height](const vec3f& v) {
         const auto calc_img_coord = [](const auto obj_coord, const auto image_dimension) {
-            return static_cast<int>((obj_coord + 1.f) * image_dimension / 2.f + .5f);
+            return (obj_coord + 1.f) * image_dimension / 2.f + .5f;
         };
 
-        return {
-            vec3f{ static_cast<float>(calc_img_coord(get_x(v), width)),
-                   static_cast<float>(calc_img_coord(get_y(v), height)),
-                   get_z(v) }...
+        return vec3f{ calc_img_coord(get_x(v), width), calc_img_coord(get_y(v), height), get_z(v) };
+    };
+
+    // Vertices are transformed once in a batch, however many triangles share
+    // them. They are snapped to pixels only once culling has clipped away
+    // whatever lies too far off screen.
+    FrameArena::Vector<vec3f> screen_positions(mesh.positions.size(), &m_arena);
+    std::transform(mesh.positions.begin(), mesh.positions.end(),
+        screen_positions.begin(), to_screen_coords);
+
+    stats.trianglesSubmitted += mesh.TriangleCount();
+    const ClipVolume volume{ static_cast<float_t>(width), static_cast<float_t>(height), m_nearZ, m_backFaceCulling };
+    Triangle snapped;
+    ClippedPolygon polygon;
+    for (size_t triangle = 0; triangle < mesh.TriangleCount(); ++triangle)
+    {
+        const auto first = triangle * 3;
+        const auto i0 = mesh.positionIndices[first];
+        const auto i1 = mesh.positionIndices[first + 1];
+        const auto i2 = mesh.positionIndices[first + 2];
+
+        const auto culled = CullTriangle({ screen_positions[i0], screen_positions[i1], screen_positions[i2] },
+            volume, snapped, polygon);
+        if (culled == CullResult::BackFacing)
+        {
+            ++stats.trianglesBackFacing;
+            continue;
+        }
+        if (culled == CullResult::Degenerate || culled == CullResult::OffScreen)
+        {
+            ++stats.trianglesCulled;
+            continue;
+        }
+
+        const auto intensities = vertex_shader(mesh, first);
+        const TexCoords texture_coords{
+            mesh.textureCoords[mesh.textureIndices[first]],
+            mesh.textureCoords[mesh.textureIndices[first + 1]],
+            mesh.textureCoords[mesh.textureIndices[first + 2]] };
+
+        if (culled == CullResult::Accepted)
+        {
+            submit({ snapped, texture_coords, intensities });
+            continue;
+        }
+
+        ++stats.trianglesClipped;
+        const auto uv = [&texture_coords](const ClipVertex& v) {
+            return texture_coords[0] * v.weights[0] + texture_coords[1] * v.weights[1] + texture_coords[2] * v.weights[2];
         };
+        const auto intensity = [&intensities](const ClipVertex& v) { return dot(intensities, v.weights); };
+        const auto& origin = polygon.vertices[0];
+        for (size_t i = 1; i + 1 < polygon.count; ++i)
+        {
+            const auto& v1 = polygon.vertices[i];
+            const auto& v2 = polygon.vertices[i + 1];
+            submit({ Triangle{ origin.position, v1.position, v2.position },
+                     TexCoords{ uv(origin), uv(v1), uv(v2) },
+                     vec3f{ intensity(origin), intensity(v1), intensity(v2) } });
+        }
+    }
+}
+
+template <typename VertexShader, typename FragmentShader, typename Sampler>
+void Renderer::RenderMesh(const MeshView& mesh,
+    const VertexShader& vertex_shader,
+    const FragmentShader& fragment_shader,
+    const Sampler& sampler,
+    const PixelView& pixels,
+    DepthBuffer& depth)
+{
+    // Everything only needed for this render comes from the arena.
+    const FrameArena::Scope arena_scope(m_arena);
+    m_activeDepth = &depth;
+    ResetHiZCounters();
+
+    const auto full_image = FullImage(pixels);
+    const auto collect = m_threadCount > 1 || m_deferred || m_multisample.GetSampleCount() > 1;
+    RenderStats stats;
+    FrameArena::Vector<ScreenTriangle> screen_triangles(&m_arena);
+    if (collect)
+        screen_triangles.reserve(mesh.TriangleCount());
+    CullMesh(mesh, vertex_shader, ImageSize{ pixels.width, pixels.height }, stats,
+        [&](const ScreenTriangle& triangle_to_render) {
+            if (collect)
+                screen_triangles.push_back(triangle_to_render);
+            else
+                RenderTriangle(triangle_to_render, fragment_shader, sampler, pixels, full_image, stats);
+        });
+    MergeStats(stats);
+
+    RenderScreenTriangles(screen_triangles, fragment_shader, sampler, pixels);
+}
+
+template <typename VertexShader, typename FragmentShader, typename Sampler>
+void Renderer::RenderMeshInBands(const MeshView& mesh,
+    const VertexShader& vertex_shader,
+    const FragmentShader& fragment_shader,
+    const Sampler& sampler,
+    const ImageSize& size,
+    const Height band_height,
+    FrameBuffer& band,
+    const BandWriter& write_band)
+{
+    const auto[width, height] = size;
+    if (width == 0 || height == 0)
+        return;
+    if (band_height == 0)
+        throw std::runtime_error("Bands need at least one row");
+
+    // Screen triangles outlive the arena resets between bands.
+    ResetHiZCounters();
+    RenderStats stats;
+    std::vector<ScreenTriangle> triangles;
+    {
+        const FrameArena::Scope arena_scope(m_arena);
+        CullMesh(mesh, vertex_shader, size, stats,
+            [&triangles](const ScreenTriangle& triangle) { triangles.push_back(triangle); });
+    }
+    MergeStats(stats);
+
+    // Bands go from the top of the picture, its last row, down. Bins are
+    // packed like tile bins and keep submission order.
+    const auto band_count = (height + band_height - 1) / band_height;
+    const auto band_range = [&](const ScreenTriangle& triangle) {
+        const auto bbox = CalculateBoundingBox(triangle.triangle, size);
+        return std::pair{
+            (height - 1 - static_cast<size_t>(get_y(bbox.max))) / band_height,
+            (height - 1 - static_cast<size_t>(get_y(bbox.min))) / band_height };
+    };
+    std::vector<uint32_t> bin_start(band_count + 1, 0);
+    for (const auto& triangle : triangles)
+    {
+        const auto[first, last] = band_range(triangle);
+        for (auto b = first; b <= last; ++b)
+        {
+            ++bin_start[b + 1];
+        }
+    }
+    std::partial_sum(bin_start.begin(), bin_start.end(), bin_start.begin());
+
+    std::vector<uint32_t> bins(bin_start.back());
+    std::vector<uint32_t> bin_end(bin_start.begin(), bin_start.end() - 1);
+    for (uint32_t i = 0; i < triangles.size(); ++i)
+    {
+        const auto[first, last] = band_range(triangles[i]);
+        for (auto b = first; b <= last; ++b)
+        {
+            bins[bin_end[b]++] = i;
+        }
+    }
+
+    // Snapped vertices sit on whole pixels, so moving them down to the band
+    // is exact and every band matches the same rows of a full render.
+    for (size_t b = 0; b < band_count; ++b)
+    {
+        const auto top = height - b * band_height;
+        const auto rows = std::min(band_height, top);
+        const auto offset = static_cast<float_t>(top - rows);
+        band.CreateImage(width, rows);
+        m_activeDepth = &band.Depth();
+
+        const FrameArena::Scope arena_scope(m_arena);
+        FrameArena::Vector<ScreenTriangle> band_triangles(&m_arena);
+        band_triangles.reserve(bin_start[b + 1] - bin_start[b]);
+        for (auto i = bin_start[b]; i < bin_start[b + 1]; ++i)
+        {
+            auto triangle = triangles[bins[i]];
+            for (auto& vertex : triangle.triangle)
+            {
+                vertex[1] -= offset;
+            }
+            band_triangles.push_back(triangle);
+        }
+
+        RenderScreenTriangles(band_triangles, fragment_shader, sampler, band.GetPixels());
+        write_band(std::as_const(band).GetPixels());
+    }
+}
+
+template <typename FragmentShader, typename Sampler>
+void Renderer::RenderScreenTriangles(const FrameArena::Vector<ScreenTriangle>& screen_triangles,
+    const FragmentShader& fragment_shader,
+    const Sampler& sampler,
+    const PixelView& pixels)
+{
+    if (screen_triangles.empty())
+        return;
+
+    switch (m_multisample.GetSampleCount())
+    {
+    case 4:
+        RenderMultisampled<4>(screen_triangles, fragment_shader, sampler, pixels);
+        return;
+    case 8:
+        RenderMultisampled<8>(screen_triangles, fragment_shader, sampler, pixels);
+        return;
+    default:
+        break;
+    }
+
+    const auto width = pixels.width;
+    const auto height = pixels.height;
+    const ImageSize size{ width, height };
+    if (!m_deferred || !FragmentShader::writes_color)
+    {
+        RenderBinned(screen_triangles, size, [&](const uint32_t idx, const BoundingBox& clip, RenderStats& tile_stats) {
+            RenderTriangle(screen_triangles[idx], fragment_shader, sampler, pixels, clip, tile_stats);
+        });
+        return;
+    }
+
+    // Pass one only resolves visibility; whatever owns a pixel at the end is
+    // what forward rendering would have shaded last.
+    m_visibilityBuffer.assign(width*height, VisibilitySample{ no_triangle, vec3f{ 0.f, 0.f, 0.f } });
+    const auto resolve_visibility = [&](const uint32_t idx, const BoundingBox& clip, RenderStats& tile_stats) {
+        RasterizeTriangle(screen_triangles[idx].triangle, clip, size, tile_stats,
+            [this, idx, width = width](const int32_t x, const int32_t y, const vec3f& barycentric) {
+                m_visibilityBuffer[static_cast<size_t>(x) + static_cast<size_t>(y) * width] = { idx, barycentric };
+            });
     };
 
-    m_zBuffer.resize(width*height);
-    std::fill(m_zBuffer.begin(), m_zBuffer.end(), -std::numeric_limits<float_t>::max());
-    while (const auto shape = model.GetNextShape())
+    if (m_threadCount > 1)
     {
-        while (const auto& polygon = shape->GetNextPolygon())
+        RenderBinned(screen_triangles, size, resolve_visibility);
+    }
+    else
+    {
+        const auto full_image = FullImage(pixels);
+        RenderStats visibility_stats;
+        for (uint32_t i = 0; i < screen_triangles.size(); ++i)
         {
-            const auto&[v0, v1, v2] = polygon->vertices;
-            const auto&[t0, t1, t2] = polygon->textureCoordinates;
+            resolve_visibility(i, full_image, visibility_stats);
+        }
+        MergeStats(visibility_stats);
+    }
+
+    if constexpr (FragmentShader::writes_color)
+        ShadeVisibilityBuffer(screen_triangles, fragment_shader, sampler, pixels);
+}
+
+template <uint32_t Samples, typename FragmentShader, typename Sampler>
+void Renderer::RenderMultisampled(const FrameArena::Vector<ScreenTriangle>& screen_triangles,
+    const FragmentShader& fragment_shader,
+    const Sampler& sampler,
+    const PixelView& pixels)
+{
+    m_multisample.Reset(ConstPixelView{ pixels.data, pixels.width, pixels.height, pixels.bytesPerPixel });
+    RenderBinned(screen_triangles, ImageSize{ pixels.width, pixels.height },
+        [&](const uint32_t idx, const BoundingBox& clip, RenderStats& stats) {
+            const auto& triangle = screen_triangles[idx];
+            const auto setup = SetupTriangle(triangle.triangle);
+            if (!setup)
+                return;
+            const auto region = MultisampleRegion(*setup, clip);
+            if (!region)
+                return;
 
-            const auto intensity = CalculateLightIntensity({ v0, v1, v2 });
-            if (intensity > 0)
+            if constexpr (!FragmentShader::writes_color)
             {
-                RenderTriangle(triangle_to_screen_coords(v0, v1, v2),
-                    { t0, t1, t2 }, intensity, out_image, texture);
+                CountFragments(stats, RegionArea(*region), RasterizeMultisampled<Samples>(*setup, clip, m_multisample,
+                    [](const int32_t, const int32_t, const vec3f&, const uint32_t) {}));
             }
+            else
+            {
+                const auto shade = fragment_shader.ForTriangle(triangle, sampler.ForTriangle(triangle));
+                const auto count = RasterizeMultisampled<Samples>(*setup, clip, m_multisample,
+                    [&](const int32_t x, const int32_t y, const vec3f& barycentric, const uint32_t mask) {
+                        const auto fragment = shade(barycentric);
+                        m_multisample.Shade(x, y, mask, fragment.intensity, fragment.color);
+                    });
+                CountFragments(stats, RegionArea(*region), count);
+                stats.textureFetches += count.passed * FragmentShader::texture_fetches;
+            }
+        });
+
+    std::atomic<size_t> next_row{ 0 };
+    m_workers.Run([&]() {
+        for (auto y = next_row++; y < pixels.height; y = next_row++)
+        {
+            m_multisample.ResolveRow(pixels, y);
         }
+    });
+}
+
+template <typename FragmentShader, typename Sampler>
+void Renderer::ShadeVisibilityBuffer(const FrameArena::Vector<ScreenTriangle>& triangles,
+    const FragmentShader& fragment_shader,
+    const Sampler& sampler,
+    const PixelView& pixels)
+{
+    using TriangleShade = decltype(fragment_shader.ForTriangle(triangles.front(), sampler.ForTriangle(triangles.front())));
+
+    std::atomic<size_t> next_row{ 0 };
+    const auto worker = [&]() {
+        // Neighbouring pixels mostly belong to the same triangle, so its
+        // texture lookup is only set up again when the triangle changes.
+        std::optional<TriangleShade> shade;
+        auto current = no_triangle;
+        RenderStats stats;
+        for (auto y = next_row++; y < pixels.height; y = next_row++)
+        {
+            const auto row = m_visibilityBuffer.data() + y * pixels.width;
+            for (size_t x = 0; x < pixels.width; ++x)
+            {
+                const auto& visibility = row[x];
+                if (visibility.triangle == no_triangle)
+                    continue;
+
+                if (visibility.triangle != current)
+                {
+                    current = visibility.triangle;
+                    shade.emplace(fragment_shader.ForTriangle(triangles[current], sampler.ForTriangle(triangles[current])));
+                }
+                const auto fragment = (*shade)(visibility.barycentric);
+                pixels.Set(static_cast<int32_t>(x), static_cast<int32_t>(y), fragment.intensity, fragment.color);
+                stats.textureFetches += FragmentShader::texture_fetches;
+            }
+        }
+        MergeStats(stats);
+    };
+
+    m_workers.Run(worker);
+}
+
+template <typename RenderFunc>
+void Renderer::RenderBinned(const FrameArena::Vector<ScreenTriangle>& triangles, const ImageSize& size, RenderFunc&& render)
+{
+    const auto[width, height] = size;
+    const auto tiles_x = (width + tile_size - 1) / tile_size;
+    const auto tiles_y = (height + tile_size - 1) / tile_size;
+
+    // Bins keep submission order, so every pixel sees the same sequence of
+    // depth tests as in the single-threaded path. They are packed back to back
+    // in one array: a first pass counts each bin, a second fills them in.
+    const auto tile_count = tiles_x * tiles_y;
+    FrameArena::Vector<PixelRegion> tile_ranges(triangles.size(), &m_arena);
+    FrameArena::Vector<uint32_t> bin_start(tile_count + 1, 0, &m_arena);
+    const auto for_each_tile = [tiles_x](const PixelRegion& range, const auto& func) {
+        for (auto ty = range.minY; ty <= range.maxY; ++ty)
+        {
+            for (auto tx = range.minX; tx <= range.maxX; ++tx)
+            {
+                func(static_cast<size_t>(tx) + static_cast<size_t>(ty) * tiles_x);
+            }
+        }
+    };
+
+    for (uint32_t i = 0; i < triangles.size(); ++i)
+    {
+        const auto bbox = CalculateBoundingBox(triangles[i].triangle, size);
+        tile_ranges[i] = {
+            static_cast<int32_t>(static_cast<size_t>(get_x(bbox.min)) / tile_size),
+            static_cast<int32_t>(static_cast<size_t>(get_y(bbox.min)) / tile_size),
+            static_cast<int32_t>(static_cast<size_t>(get_x(bbox.max)) / tile_size),
+            static_cast<int32_t>(static_cast<size_t>(get_y(bbox.max)) / tile_size) };
+        for_each_tile(tile_ranges[i], [&bin_start](const size_t tile) { ++bin_start[tile + 1]; });
     }
+    std::partial_sum(bin_start.begin(), bin_start.end(), bin_start.begin());
+
+    FrameArena::Vector<uint32_t> bins(bin_start.back(), &m_arena);
+    FrameArena::Vector<uint32_t> bin_end(bin_start.begin(), bin_start.end() - 1, &m_arena);
+    for (uint32_t i = 0; i < triangles.size(); ++i)
+    {
+        for_each_tile(tile_ranges[i], [&](const size_t tile) { bins[bin_end[tile]++] = i; });
+    }
+
+    // Tiles are disjoint, so each worker owns its slice of the z-buffer and
+    // the output image without any locking.
+    std::atomic<size_t> next_tile{ 0 };
+    const auto worker = [&]() {
+        RenderStats stats;
+        for (auto tile = next_tile++; tile < tile_count; tile = next_tile++)
+        {
+            const auto tx = tile % tiles_x;
+            const auto ty = tile / tiles_x;
+            const BoundingBox tile_box{
+                vec2f{ static_cast<float>(tx * tile_size), static_cast<float>(ty * tile_size) },
+                vec2f{ static_cast<float>(std::min(width, (tx + 1) * tile_size) - 1),
+                       static_cast<float>(std::min(height, (ty + 1) * tile_size) - 1) } };
+
+            for (auto i = bin_start[tile]; i < bin_start[tile + 1]; ++i)
+            {
+                render(bins[i], tile_box, stats);
+            }
+        }
+        MergeStats(stats);
+    };
+
+    m_workers.Run(worker);
 }
 
 void Renderer::RenderLine(const vec2i& v0, const vec2i& v1, IImg& image, const IColor& color)
@@ -120,46 +682,292 @@ void Renderer::RenderLine(const vec2i& v0, const vec2i& v1, IImg& image, const I
 
 void Renderer::RenderTriangle(const Triangle & triangle, const TexCoords & texture_coords, const float_t intensity, IImg & out_image, IImg & texture)
 {
-    const auto size = out_image.GetImageSize();
-    const auto[width, height] = size;
-    const auto buffer_idx = [&](const auto& x, const auto& y) {
-        return size_t(x + y * width);
+    const auto pixels = out_image.GetPixels();
+    if (m_depth.GetSize() != ImageSize{ pixels.width, pixels.height })
+        ResetDepth(out_image.GetImageSize());
+    m_activeDepth = &m_depth;
+
+    RenderStats stats;
+    stats.trianglesSubmitted = 1;
+    RenderTriangle(ScreenTriangle{ triangle, texture_coords, vec3f{ intensity, intensity, intensity } }, FlatFragmentShader{},
+        ImageSampler{ *this, std::as_const(texture).GetPixels() }, pixels, FullImage(pixels), stats);
+    MergeStats(stats);
+}
+
+template <typename FragmentShader, typename Sampler>
+void Renderer::RenderTriangle(const ScreenTriangle& triangle,
+    const FragmentShader& fragment_shader,
+    const Sampler& sampler,
+    const PixelView& pixels,
+    const BoundingBox& clip,
+    RenderStats& stats)
+{
+    const ImageSize size{ pixels.width, pixels.height };
+    if constexpr (!FragmentShader::writes_color)
+    {
+        RasterizeTriangle(triangle.triangle, clip, size, stats, [](const int32_t, const int32_t, const vec3f&) {});
+    }
+    else
+    {
+        const auto shade = fragment_shader.ForTriangle(triangle, sampler.ForTriangle(triangle));
+        const auto depth_passed = stats.depthPassed;
+        RasterizeTriangle(triangle.triangle, clip, size, stats,
+            [&](const int32_t x, const int32_t y, const vec3f& barycentric) {
+                const auto fragment = shade(barycentric);
+                pixels.Set(x, y, fragment.intensity, fragment.color);
+            });
+        stats.textureFetches += (stats.depthPassed - depth_passed) * FragmentShader::texture_fetches;
+    }
+}
+
+template <typename ShadeFunc>
+void Renderer::RasterizeTriangle(const Triangle& triangle,
+    const BoundingBox& clip,
+    const ImageSize& size,
+    RenderStats& stats,
+    ShadeFunc&& shade)
+{
+    const auto setup = SetupTriangle(triangle);
+    if (!setup)
+        return;
+
+    const auto region = ClipRegion(*setup, clip);
+    if (!region)
+        return;
+
+    switch (m_activeDepth->GetFormat())
+    {
+    case DepthFormat::Float32:
+        DepthTestTriangle<Float32Depth>(*setup, *region, clip, size, stats, shade);
+        break;
+    case DepthFormat::Unorm16:
+        DepthTestTriangle<Unorm16Depth>(*setup, *region, clip, size, stats, shade);
+        break;
+    case DepthFormat::Unorm24:
+        DepthTestTriangle<Unorm24Depth>(*setup, *region, clip, size, stats, shade);
+        break;
+    case DepthFormat::Compressed:
+        DepthTestCompressed(*setup, *region, size, stats, shade);
+        break;
+    }
+}
+
+template <typename Format, typename ShadeFunc>
+void Renderer::DepthTestTriangle(const TriangleSetup& setup,
+    const PixelRegion& region,
+    const BoundingBox& clip,
+    const ImageSize& size,
+    RenderStats& stats,
+    ShadeFunc& shade)
+{
+    const auto width = std::get<0>(size);
+    const auto height = std::get<1>(size);
+    const auto depth = m_activeDepth->View<Format>();
+    auto& hi_z = m_activeDepth->HiZ();
+
+    if (!m_hiZEnabled)
+    {
+        CountFragments(stats, RegionArea(region), RasterizeDepthTested(m_simdLevel, setup, clip, depth, shade));
+        return;
+    }
+
+    const auto z_max = static_cast<float_t>(Format::Encode(DepthBound(setup)));
+    const auto first_bx = region.minX >> HiZBuffer::block_shift;
+    const auto last_bx = region.maxX >> HiZBuffer::block_shift;
+    const auto first_by = region.minY >> HiZBuffer::block_shift;
+    const auto last_by = region.maxY >> HiZBuffer::block_shift;
+    const auto blocks = static_cast<uint64_t>(last_bx - first_bx + 1) * (last_by - first_by + 1);
+
+    uint64_t rejected = 0;
+    for (auto by = first_by; by <= last_by; ++by)
+    {
+        for (auto bx = first_bx; bx <= last_bx; ++bx)
+        {
+            rejected += hi_z.IsOccluded(bx, by, z_max);
+        }
+    }
+
+    ++stats.hiZ.trianglesTested;
+    stats.hiZ.blocksTested += blocks;
+    stats.hiZ.blocksRejected += rejected;
+    if (rejected == blocks)
+    {
+        ++stats.hiZ.trianglesRejected;
+        return;
+    }
+
+    PixelRegion written{ region.maxX, region.maxY, region.minX, region.minY };
+    const auto shade_and_track = [&](const int32_t x, const int32_t y, const vec3f& barycentric) {
+        shade(x, y, barycentric);
+        written.minX = std::min(written.minX, x);
+        written.minY = std::min(written.minY, y);
+        written.maxX = std::max(written.maxX, x);
+        written.maxY = std::max(written.maxY, y);
+    };
+
+    // Each block row is rasterized as runs of consecutive visible blocks.
+    uint64_t tested = 0;
+    FragmentCount count;
+    const auto rasterize_run = [&](const int32_t from_bx, const int32_t to_bx, const int32_t by) {
+        const PixelRegion run{
+            std::max(region.minX, from_bx << HiZBuffer::block_shift),
+            std::max(region.minY, by << HiZBuffer::block_shift),
+            std::min(region.maxX, ((to_bx + 1) << HiZBuffer::block_shift) - 1),
+            std::min(region.maxY, ((by + 1) << HiZBuffer::block_shift) - 1) };
+        tested += RegionArea(run);
+        count += RasterizeDepthTested(m_simdLevel, setup, RegionBox(run), depth, shade_and_track);
     };
 
-    const auto is_inside_triangle = [](const auto& barycentric)
+    for (auto by = first_by; by <= last_by; ++by)
     {
-        return !(get_x(barycentric) < 0.f ||
-            get_y(barycentric) < 0.f ||
-            get_z(barycentric) < 0.f);
+        auto run_start = first_bx;
+        for (auto bx = first_bx; bx <= last_bx; ++bx)
+        {
+            if (hi_z.IsOccluded(bx, by, z_max))
+            {
+                if (run_start < bx)
+                    rasterize_run(run_start, bx - 1, by);
+                run_start = bx + 1;
+            }
+        }
+        if (run_start <= last_bx)
+            rasterize_run(run_start, last_bx, by);
+    }
+
+    CountFragments(stats, tested, count);
+    if (written.minX <= written.maxX)
+        hi_z.Update(depth, width, height, written);
+}
+
+// Goes block by block, as each one may be stored differently. A block the
+// triangle covers entirely and passes everywhere becomes (or stays) a plane,
+// one it misses or fails everywhere is left alone; anything else is expanded
+// and depth tested by the usual kernels.
+template <typename ShadeFunc>
+void Renderer::DepthTestCompressed(const TriangleSetup& setup,
+    const PixelRegion& region,
+    const ImageSize& size,
+    RenderStats& stats,
+    ShadeFunc& shade)
+{
+    using Tile = CompressedDepth::TileState;
+    const auto width = static_cast<int32_t>(std::get<0>(size));
+    const auto height = static_cast<int32_t>(std::get<1>(size));
+    auto& depth = m_activeDepth->Compressed();
+    auto& hi_z = m_activeDepth->HiZ();
+    const auto z_max = DepthBound(setup);
+
+    const auto covers = [&setup](const int32_t x, const int32_t y) {
+        const auto w = StartScanline(setup, x, y).w;
+        return (w[0] | w[1] | w[2]) >= 0;
+    };
+    // Edge functions are linear, so a block is missed when all its corners
+    // are outside the same edge.
+    const auto misses = [&setup](const PixelRegion& block) {
+        const auto corners = {
+            StartScanline(setup, block.minX, block.minY).w, StartScanline(setup, block.maxX, block.minY).w,
+            StartScanline(setup, block.minX, block.maxY).w, StartScanline(setup, block.maxX, block.maxY).w };
+        for (size_t i = 0; i < 3; ++i)
+        {
+            if (std::all_of(corners.begin(), corners.end(), [i](const auto& w) { return w[i] < 0; }))
+                return true;
+        }
+        return false;
     };
 
-    const auto bbox = CalculateBoundingBox(triangle, size);
-    for (auto x = get_x(bbox.min); x <= get_x(bbox.max); ++x)
+    uint64_t blocks = 0;
+    uint64_t rejected = 0;
+    uint64_t tested = 0;
+    FragmentCount count;
+    for (auto by = region.minY >> CompressedDepth::tile_shift; by <= region.maxY >> CompressedDepth::tile_shift; ++by)
     {
-        for (auto y = get_y(bbox.min); y <= get_y(bbox.max); ++y)
+        for (auto bx = region.minX >> CompressedDepth::tile_shift; bx <= region.maxX >> CompressedDepth::tile_shift; ++bx)
         {
-            const auto barycentric = CalculateBarycentric({ x,y,0.f }, triangle);
-            if (barycentric)
+            ++blocks;
+            if (m_hiZEnabled && hi_z.IsOccluded(bx, by, z_max))
             {
-                if (!is_inside_triangle(*barycentric))
-                    continue;
+                ++rejected;
+                continue;
+            }
+
+            const PixelRegion tile{
+                bx << CompressedDepth::tile_shift,
+                by << CompressedDepth::tile_shift,
+                std::min(width, (bx + 1) << CompressedDepth::tile_shift) - 1,
+                std::min(height, (by + 1) << CompressedDepth::tile_shift) - 1 };
+            const PixelRegion block{
+                std::max(region.minX, tile.minX),
+                std::max(region.minY, tile.minY),
+                std::min(region.maxX, tile.maxX),
+                std::min(region.maxY, tile.maxY) };
+            tested += RegionArea(block);
+            if (misses(block))
+                continue;
 
-                float z = 0.f;
-                for (size_t i = 0; i < triangle.size(); ++i)
+            auto& state = depth.At(bx, by);
+            const auto whole = block.minX == tile.minX && block.minY == tile.minY
+                && block.maxX == tile.maxX && block.maxY == tile.maxY
+                && covers(tile.minX, tile.minY) && covers(tile.maxX, tile.minY)
+                && covers(tile.minX, tile.maxY) && covers(tile.maxX, tile.maxY);
+            if (whole && state.state != Tile::Raw)
+            {
+                uint64_t passed = 0;
+                auto min_z = std::numeric_limits<float_t>::max();
+                for (auto y = tile.minY; y <= tile.maxY; ++y)
                 {
-                    z += get_z(triangle[i])*barycentric->at(i);
+                    const auto scanline = StartScanline(setup, tile.minX, y);
+                    for (auto x = tile.minX; x <= tile.maxX; ++x)
+                    {
+                        const auto z = InterpolateDepth(setup, PixelBarycentric(setup, scanline, x));
+                        const auto old_z = state.state == Tile::Clear
+                            ? Float32Depth::clear
+                            : CompressedDepth::PlaneDepth(state.plane, x, y);
+                        passed += old_z < z;
+                        min_z = std::min(min_z, z);
+                    }
                 }
-                if (m_zBuffer[buffer_idx(x, y)] < z)
+
+                const auto pixels = RegionArea(tile);
+                if (passed == 0)
                 {
-                    m_zBuffer[buffer_idx(x, y)] = z;
-                    out_image.SetPixelColor(
-                        static_cast<int32_t>(x),
-                        static_cast<int32_t>(y),
-                        intensity,
-                        *GetColorFromTexture(*barycentric, texture_coords, texture));
+                    count += FragmentCount{ pixels, 0 };
+                    continue;
+                }
+                if (passed == pixels)
+                {
+                    state.state = Tile::Plane;
+                    state.plane = CompressedDepth::PlaneOf(setup);
+                    for (auto y = tile.minY; y <= tile.maxY; ++y)
+                    {
+                        const auto scanline = StartScanline(setup, tile.minX, y);
+                        for (auto x = tile.minX; x <= tile.maxX; ++x)
+                        {
+                            shade(x, y, PixelBarycentric(setup, scanline, x));
+                        }
+                    }
+                    count += FragmentCount{ pixels, pixels };
+                    if (m_hiZEnabled)
+                        hi_z.Set(bx, by, min_z);
+                    continue;
                 }
             }
+
+            if (state.state != Tile::Raw)
+                depth.Expand(bx, by);
+            const auto raw = depth.RawView(bx, by);
+            const auto block_count = RasterizeDepthTested(m_simdLevel, setup, RegionBox(block), raw, shade);
+            count += block_count;
+            if (m_hiZEnabled && block_count.passed != 0)
+                hi_z.Update(raw, static_cast<Width>(width), static_cast<Height>(height), block);
         }
     }
-}
 
+    if (m_hiZEnabled)
+    {
+        ++stats.hiZ.trianglesTested;
+        stats.hiZ.blocksTested += blocks;
+        stats.hiZ.blocksRejected += rejected;
+        stats.hiZ.trianglesRejected += rejected == blocks;
+    }
+    CountFragments(stats, tested, count);
+}
@@ -1,33 +1,199 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <variant>
 #include <vector>
+#include "framearena.hpp"
+#include "framebuffer.hpp"
 #include "img.hpp"
+#include "meshlod.hpp"
 #include "model.hpp"
+#include "multisample.hpp"
+#include "rasterizer.hpp"
+#include "renderstats.hpp"
+#include "texture.hpp"
+#include "workerpool.hpp"
 #include "hola/hola.hpp"
 
 using namespace hola;
 
-using Triangle = std::array<vec3f, 3>;
 using TexCoords = std::array<vec2f, 3>;
-using ZBuffer = std::vector<float_t>;
 using Point = vec3f;
 
-struct BoundingBox
+struct ScreenTriangle
 {
-    vec2f min;
-    vec2f max;
+    Triangle triangle;
+    TexCoords textureCoordinates;
+    // Light intensity at each corner, as computed by the vertex shader.
+    vec3f intensities;
 };
 
+enum class Shading
+{
+    Flat,
+    Gouraud,
+    NormalMapped,
+    DepthOnly
+};
+
+// What pass one of deferred shading leaves for a pixel: the triangle that won
+// the depth test and where inside it the pixel lies.
+struct VisibilitySample
+{
+    uint32_t triangle;
+    vec3f barycentric;
+};
+
+// Takes the bands of RenderModelInBands, top of the picture first. Each
+// band's first row is its bottom, like in any other image.
+using BandWriter = std::function<void(const ConstPixelView& band)>;
+
 class Renderer
 {
     vec3f m_lightVector;
-    ZBuffer m_zBuffer;
+    DepthBuffer m_depth;
+    // Depth of the target being rendered: m_depth for plain images, the
+    // framebuffer's own otherwise.
+    DepthBuffer* m_activeDepth = &m_depth;
+    FrameArena m_arena;
+    MultisampleBuffer m_multisample;
+    std::vector<VisibilitySample> m_visibilityBuffer;
+    bool m_hiZEnabled = true;
+    bool m_deferred = false;
+    bool m_statsEnabled = false;
+    bool m_backFaceCulling = true;
+    Shading m_shading = Shading::Flat;
+    std::shared_ptr<const Texture> m_normalMap;
+    float_t m_nearZ = 1.f;
+    float_t m_lodError = 0.f;
+    uint32_t m_threadCount = 1;
+    WorkerPool m_workers;
+    SimdLevel m_simdLevel = DetectSimdLevel();
+    HiZStats m_hiZStats;
+    RenderStats m_stats;
+    mutable std::mutex m_statsMutex;
+
+    template <typename MeshFunc>
+    void WithShaders(MeshFunc&& render_mesh);
+    template <typename Sampler>
+    void RenderShaded(const MeshView& mesh, const Sampler& sampler, const PixelView& pixels, DepthBuffer& depth);
+    void ResetHiZCounters();
+    template <typename VertexShader, typename SubmitFunc>
+    void CullMesh(const MeshView& mesh,
+        const VertexShader& vertex_shader,
+        const ImageSize& size,
+        RenderStats& stats,
+        SubmitFunc&& submit);
+    template <typename VertexShader, typename FragmentShader, typename Sampler>
+    void RenderMesh(const MeshView& mesh,
+        const VertexShader& vertex_shader,
+        const FragmentShader& fragment_shader,
+        const Sampler& sampler,
+        const PixelView& pixels,
+        DepthBuffer& depth);
+    template <typename VertexShader, typename FragmentShader, typename Sampler>
+    void RenderMeshInBands(const MeshView& mesh,
+        const VertexShader& vertex_shader,
+        const FragmentShader& fragment_shader,
+        const Sampler& sampler,
+        const ImageSize& size,
+        const Height band_height,
+        FrameBuffer& band,
+        const BandWriter& write_band);
+    template <typename FragmentShader, typename Sampler>
+    void RenderScreenTriangles(const FrameArena::Vector<ScreenTriangle>& screen_triangles,
+        const FragmentShader& fragment_shader,
+        const Sampler& sampler,
+        const PixelView& pixels);
+    template <uint32_t Samples, typename FragmentShader, typename Sampler>
+    void RenderMultisampled(const FrameArena::Vector<ScreenTriangle>& screen_triangles,
+        const FragmentShader& fragment_shader,
+        const Sampler& sampler,
+        const PixelView& pixels);
+    template <typename RenderFunc>
+    void RenderBinned(const FrameArena::Vector<ScreenTriangle>& triangles, const ImageSize& size, RenderFunc&& render);
+    template <typename FragmentShader, typename Sampler>
+    void RenderTriangle(const ScreenTriangle& triangle,
+        const FragmentShader& fragment_shader,
+        const Sampler& sampler,
+        const PixelView& pixels,
+        const BoundingBox& clip,
+        RenderStats& stats);
+    template <typename ShadeFunc>
+    void RasterizeTriangle(const Triangle& triangle,
+        const BoundingBox& clip,
+        const ImageSize& size,
+        RenderStats& stats,
+        ShadeFunc&& shade);
+    template <typename Format, typename ShadeFunc>
+    void DepthTestTriangle(const TriangleSetup& setup,
+        const PixelRegion& region,
+        const BoundingBox& clip,
+        const ImageSize& size,
+        RenderStats& stats,
+        ShadeFunc& shade);
+    template <typename ShadeFunc>
+    void DepthTestCompressed(const TriangleSetup& setup,
+        const PixelRegion& region,
+        const ImageSize& size,
+        RenderStats& stats,
+        ShadeFunc& shade);
+    void MergeStats(const RenderStats& stats);
+    template <typename FragmentShader, typename Sampler>
+    void ShadeVisibilityBuffer(const FrameArena::Vector<ScreenTriangle>& triangles,
+        const FragmentShader& fragment_shader,
+        const Sampler& sampler,
+        const PixelView& pixels);
 
 public:
     void SetLightVector(const vec3f& light_vector) { m_lightVector = light_vector; }
+    void SetThreadCount(const uint32_t thread_count);
+    void SetSimdLevel(const SimdLevel level) { m_simdLevel = std::min(level, DetectSimdLevel()); }
+    void SetHierarchicalZ(const bool enabled) { m_hiZEnabled = enabled; }
+    void SetDeferredShading(const bool enabled) { m_deferred = enabled; }
+    void SetShading(const Shading shading) { m_shading = shading; }
+    // Object space normal map sampled like the diffuse texture, needed by Shading::NormalMapped.
+    void SetNormalMap(std::shared_ptr<const Texture> normal_map) { m_normalMap = std::move(normal_map); }
+    void SetBackFaceCulling(const bool enabled) { m_backFaceCulling = enabled; }
+    // Larger z is nearer; geometry in front of near_z is clipped.
+    void SetNearPlane(const float_t near_z) { m_nearZ = near_z; }
+    // Format of the depth buffer used for plain images; framebuffers have their own.
+    void SetDepthFormat(const DepthFormat format) { m_depth.SetFormat(format); }
+    // 4 or 8 samples per pixel anti-alias edges, 1 turns it off. Every pixel is
+    // still shaded once per triangle; a resolve pass averages the samples. A
+    // multisampled render keeps sample depth to itself and shades forward, so
+    // it neither uses a framebuffer's depth nor defers shading.
+    void SetSampleCount(const uint32_t samples) { m_multisample.SetSampleCount(samples); }
+    // Models with simplified levels are rendered with the coarsest one whose
+    // error, at the size of the picture, stays within max_error pixels; 0
+    // always renders the full mesh.
+    void SetLevelOfDetail(const float_t max_error) { m_lodError = max_error; }
+    MeshView SelectMesh(const IModel& model, const ImageSize& size) const { return SelectLevel(model, size, m_lodError); }
+    void SetStatsEnabled(const bool enabled) { m_statsEnabled = enabled; }
+    void ResetDepth(const ImageSize& size);
+    HiZStats GetHiZStats() const;
+    // Totals over every render since the last ResetStats while stats were enabled.
+    RenderStats GetStats() const;
+    void ResetStats();
     void RenderModel(const IModel& model, IImg& texture, IImg& out_image);
+    void RenderModel(const IModel& model, const Texture& texture, IImg& out_image);
+    // Renders against the depth already in target instead of starting over.
+    void RenderModel(const IModel& model, IImg& texture, FrameBuffer& target);
+    void RenderModel(const IModel& model, const Texture& texture, FrameBuffer& target);
+    // Renders a picture of any size while only band_height rows of colour and
+    // depth exist at a time. The mesh is culled and binned to bands once; each
+    // band is then rendered into band, which keeps its depth format, and
+    // handed to write_band. Output matches RenderModel row for row.
+    void RenderModelInBands(const IModel& model,
+        const Texture& texture,
+        const ImageSize& size,
+        const Height band_height,
+        FrameBuffer& band,
+        const BandWriter& write_band);
     void RenderLine(const vec2i& v0, const vec2i& v1, IImg& image, const IColor& color);
     void RenderTriangle(const Triangle& triangle,
         const TexCoords& texture_coords,
@@ -37,6 +203,9 @@ public:
     std::unique_ptr<IColor> GetColorFromTexture(const vec3f& barycentric,
         const TexCoords& texture_coords,
         const IImg& texture);
+    RGBA GetColorFromTexture(const vec3f& barycentric,
+        const TexCoords& texture_coords,
+        const ConstPixelView& texture);
     std::optional<vec3f> CalculateBarycentric(const Point& p, const Triangle& triangle);
     BoundingBox CalculateBoundingBox(const Triangle& triangle, const ImageSize& size);
     float_t CalculateLightIntensity(const Triangle& triangle);
@@ -0,0 +1,84 @@
+#include "renderstats.hpp"
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace
+{
+    template <typename CounterFunc>
+    void ForEachCounter(const RenderStats& stats, CounterFunc&& counter)
+    {
+        counter("triangles_submitted", stats.trianglesSubmitted);
+        counter("triangles_back_facing", stats.trianglesBackFacing);
+        counter("triangles_culled", stats.trianglesCulled);
+        counter("triangles_clipped", stats.trianglesClipped);
+        counter("pixels_tested", stats.pixelsTested);
+        counter("pixels_covered", stats.pixelsCovered);
+        counter("depth_passed", stats.depthPassed);
+        counter("depth_failed", stats.depthFailed);
+        counter("texture_fetches", stats.textureFetches);
+        counter("hiz_triangles_tested", stats.hiZ.trianglesTested);
+        counter("hiz_triangles_rejected", stats.hiZ.trianglesRejected);
+        counter("hiz_blocks_tested", stats.hiZ.blocksTested);
+        counter("hiz_blocks_rejected", stats.hiZ.blocksRejected);
+    }
+}
+
+HiZStats& HiZStats::operator+=(const HiZStats& other)
+{
+    trianglesTested += other.trianglesTested;
+    trianglesRejected += other.trianglesRejected;
+    blocksTested += other.blocksTested;
+    blocksRejected += other.blocksRejected;
+    return *this;
+}
+
+RenderStats& RenderStats::operator+=(const RenderStats& other)
+{
+    trianglesSubmitted += other.trianglesSubmitted;
+    trianglesBackFacing += other.trianglesBackFacing;
+    trianglesCulled += other.trianglesCulled;
+    trianglesClipped += other.trianglesClipped;
+    pixelsTested += other.pixelsTested;
+    pixelsCovered += other.pixelsCovered;
+    depthPassed += other.depthPassed;
+    depthFailed += other.depthFailed;
+    textureFetches += other.textureFetches;
+    hiZ += other.hiZ;
+    return *this;
+}
+
+void PrintStats(std::ostream& out, const RenderStats& stats, const StageTimer& timer)
+{
+    for (const auto&[stage, ms] : timer.Stages())
+    {
+        out << std::left << std::setw(24) << stage
+            << std::right << std::fixed << std::setprecision(2) << std::setw(12) << ms << " ms\n";
+    }
+    ForEachCounter(stats, [&out](const char* name, const uint64_t value) {
+        out << std::left << std::setw(24) << name << std::right << std::setw(12) << value << '\n';
+    });
+    out.flush();
+}
+
+void WriteStatsJson(const std::filesystem::path& path, const RenderStats& stats, const StageTimer& timer)
+{
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Can't open " + path.string() + " for writing");
+
+    out << "{\n  \"stages_ms\": {";
+    auto separator = "\n";
+    for (const auto&[stage, ms] : timer.Stages())
+    {
+        out << separator << "    \"" << stage << "\": " << std::fixed << std::setprecision(3) << ms;
+        separator = ",\n";
+    }
+    out << "\n  },\n  \"counters\": {";
+    separator = "\n";
+    ForEachCounter(stats, [&](const char* name, const uint64_t value) {
+        out << separator << "    \"" << name << "\": " << value;
+        separator = ",\n";
+    });
+    out << "\n  }\n}\n";
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Outcome of hierarchical z-buffer tests: triangles and 8x8 blocks tested
+// against it and how many of them were found hidden.
+struct HiZStats
+{
+    uint64_t trianglesTested = 0;
+    uint64_t trianglesRejected = 0;
+    uint64_t blocksTested = 0;
+    uint64_t blocksRejected = 0;
+
+    HiZStats& operator+=(const HiZStats& other);
+};
+
+// Counters gathered by Renderer while stats are enabled. Workers count into
+// their own copy and merge once they are done, so the only cost of leaving
+// stats off is a handful of additions per triangle.
+struct RenderStats
+{
+    uint64_t trianglesSubmitted = 0;
+    uint64_t trianglesBackFacing = 0;
+    uint64_t trianglesCulled = 0;
+    uint64_t trianglesClipped = 0;
+    uint64_t pixelsTested = 0;
+    uint64_t pixelsCovered = 0;
+    uint64_t depthPassed = 0;
+    uint64_t depthFailed = 0;
+    uint64_t textureFetches = 0;
+    // Kept for Renderer::GetHiZStats even while stats are off.
+    HiZStats hiZ;
+
+    RenderStats& operator+=(const RenderStats& other);
+};
+
+// Wall clock time of each named stage, in the order the stages ran.
+class StageTimer
+{
+    using Clock = std::chrono::steady_clock;
+    std::vector<std::pair<std::string, double>> m_stages;
+
+public:
+    template <typename Func>
+    void Time(const std::string& stage, Func&& func)
+    {
+        const auto start = Clock::now();
+        func();
+        m_stages.emplace_back(stage, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+
+    const std::vector<std::pair<std::string, double>>& Stages() const { return m_stages; }
+};
+
+void PrintStats(std::ostream& out, const RenderStats& stats, const StageTimer& timer);
+void WriteStatsJson(const std::filesystem::path& path, const RenderStats& stats, const StageTimer& timer);
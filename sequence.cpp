@@ -0,0 +1,187 @@
+#include "sequence.hpp"
+#include "framebuffer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace
+{
+    constexpr float_t two_pi = 6.28318530718f;
+
+    template <typename T>
+    class BlockingQueue
+    {
+        std::deque<T> m_items;
+        std::mutex m_mutex;
+        std::condition_variable m_ready;
+        bool m_closed = false;
+
+    public:
+        void Push(T item)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_items.push_back(std::move(item));
+            }
+            m_ready.notify_one();
+        }
+
+        // Empty once the queue is closed and drained.
+        std::optional<T> Pop()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [this] { return m_closed || !m_items.empty(); });
+            if (m_items.empty())
+                return std::nullopt;
+
+            auto item = std::move(m_items.front());
+            m_items.pop_front();
+            return item;
+        }
+
+        void Close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_closed = true;
+            }
+            m_ready.notify_all();
+        }
+    };
+
+    vec3f RotateY(const vec3f& v, const float_t angle)
+    {
+        const auto c = std::cos(angle);
+        const auto s = std::sin(angle);
+        return vec3f{ get_x(v) * c + get_z(v) * s, get_y(v), get_z(v) * c - get_x(v) * s };
+    }
+
+    // Model whose positions and normals are turned around the y axis, sharing
+    // everything else with the source mesh.
+    class RotatedModel : public IModel
+    {
+        MeshView m_source;
+        std::vector<vec3f> m_positions;
+        std::vector<vec3f> m_normals;
+
+    public:
+        explicit RotatedModel(const MeshView& source)
+            : m_source(source)
+            , m_positions(source.positions.size())
+            , m_normals(source.normals.size())
+        {}
+
+        void Rotate(const float_t angle)
+        {
+            std::transform(m_source.positions.begin(), m_source.positions.end(), m_positions.begin(),
+                [angle](const vec3f& v) { return RotateY(v, angle); });
+            std::transform(m_source.normals.begin(), m_source.normals.end(), m_normals.begin(),
+                [angle](const vec3f& v) { return RotateY(v, angle); });
+        }
+
+        virtual void ReadModel(const std::filesystem::path&) override {}
+        virtual MeshView GetMesh() const override
+        {
+            auto mesh = m_source;
+            mesh.positions = { m_positions.data(), m_positions.size() };
+            mesh.normals = { m_normals.data(), m_normals.size() };
+            return mesh;
+        }
+    };
+
+    struct Frame
+    {
+        uint32_t index;
+        FrameBuffer* image;
+    };
+}
+
+std::filesystem::path FrameFilename(const std::filesystem::path& output, const uint32_t frame)
+{
+    std::ostringstream name;
+    name << output.stem().string() << '_' << std::setw(4) << std::setfill('0') << frame
+        << output.extension().string();
+    return output.parent_path() / name.str();
+}
+
+void RenderSequence(const IModel& model,
+    const Texture& texture,
+    Renderer& renderer,
+    const SequenceOptions& options,
+    const FrameWriter& write_frame)
+{
+    std::vector<FrameBuffer> framebuffers(options.queueDepth + 1);
+    BlockingQueue<FrameBuffer*> free_frames;
+    for (auto& framebuffer : framebuffers)
+    {
+        framebuffer.SetDepthFormat(options.depthFormat);
+        framebuffer.CreateImage(options.width, options.height);
+        free_frames.Push(&framebuffer);
+    }
+
+    BlockingQueue<Frame> finished_frames;
+    std::exception_ptr write_error;
+    std::thread writer([&]() {
+        try
+        {
+            while (const auto frame = finished_frames.Pop())
+            {
+                write_frame(std::as_const(*frame->image).GetPixels(), frame->index);
+                free_frames.Push(frame->image);
+            }
+        }
+        catch (...)
+        {
+            write_error = std::current_exception();
+            free_frames.Close();
+        }
+    });
+
+    // Turning the model doesn't change how large it looks, so the level it
+    // is rendered with is picked once.
+    RotatedModel rotated(renderer.SelectMesh(model, ImageSize{ options.width, options.height }));
+    try
+    {
+        for (uint32_t i = 0; i < options.frameCount; ++i)
+        {
+            const auto image = free_frames.Pop();
+            if (!image)
+                break;
+
+            (*image)->Clear();
+
+            const auto angle = two_pi * i / options.frameCount;
+            if (options.sweep == SequenceSweep::Light)
+            {
+                renderer.SetLightVector(RotateY(options.lightVector, angle));
+                renderer.RenderModel(model, texture, **image);
+            }
+            else
+            {
+                rotated.Rotate(angle);
+                renderer.SetLightVector(options.lightVector);
+                renderer.RenderModel(rotated, texture, **image);
+            }
+            finished_frames.Push({ i, *image });
+        }
+    }
+    catch (...)
+    {
+        finished_frames.Close();
+        writer.join();
+        throw;
+    }
+
+    finished_frames.Close();
+    writer.join();
+    if (write_error)
+        std::rethrow_exception(write_error);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include "model.hpp"
+#include "renderer.hpp"
+#include "texture.hpp"
+
+enum class SequenceSweep
+{
+    Light,
+    Rotation
+};
+
+// Frames turn the light vector or the model around the y axis, one full
+// turn over the sequence.
+struct SequenceOptions
+{
+    uint32_t frameCount = 1;
+    SequenceSweep sweep = SequenceSweep::Light;
+    Width width = 0;
+    Height height = 0;
+    vec3f lightVector = vec3f{ 0.f, 0.f, -1.f };
+    // Finished frames allowed to wait for the writer before rendering blocks.
+    uint32_t queueDepth = 2;
+    DepthFormat depthFormat = DepthFormat::Float32;
+};
+
+// out.tga becomes out_0000.tga, out_0001.tga, ...
+std::filesystem::path FrameFilename(const std::filesystem::path& output, const uint32_t frame);
+
+// Encodes and writes one finished frame; frames arrive in order.
+using FrameWriter = std::function<void(const ConstPixelView& pixels, const uint32_t frame)>;
+
+// Renders on the calling thread while a writer thread runs write_frame on
+// finished frames. Framebuffers are recycled between the two, so memory stays
+// bounded by queueDepth + 1 frames.
+void RenderSequence(const IModel& model,
+    const Texture& texture,
+    Renderer& renderer,
+    const SequenceOptions& options,
+    const FrameWriter& write_frame);
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "renderer.hpp"
+
+// A shading model is a vertex shader and a fragment shader picked at compile
+// time, so every pairing gets its own inlined rasterization loop.
+//
+// Vertex shaders light the corners of the triangle starting at index first of
+// the mesh index buffers. Fragment shaders work like samplers: ForTriangle
+// does the per-triangle setup and returns a functor mapping barycentric
+// coordinates to a ShadedFragment, given the triangle's texture lookup.
+
+struct ShadedFragment
+{
+    float_t intensity;
+    RGBA color;
+};
+
+inline float_t FaceIntensity(const Triangle& triangle, const vec3f& light_vector)
+{
+    const auto&[v0, v1, v2] = triangle;
+    const auto n = cross(v2 - v0, v1 - v0);
+    const auto normalized = normalize(n);
+
+    return dot(light_vector, normalized);
+}
+
+inline Triangle ObjectTriangle(const MeshView& mesh, const size_t first)
+{
+    return {
+        mesh.positions[mesh.positionIndices[first]],
+        mesh.positions[mesh.positionIndices[first + 1]],
+        mesh.positions[mesh.positionIndices[first + 2]] };
+}
+
+struct FlatVertexShader
+{
+    vec3f lightVector;
+
+    vec3f operator()(const MeshView& mesh, const size_t first) const
+    {
+        const auto intensity = FaceIntensity(ObjectTriangle(mesh, first), lightVector);
+        return vec3f{ intensity, intensity, intensity };
+    }
+};
+
+// Lights each corner with its OBJ normal. Corners without a normal make the
+// whole triangle fall back to its face normal.
+struct GouraudVertexShader
+{
+    vec3f lightVector;
+
+    vec3f operator()(const MeshView& mesh, const size_t first) const
+    {
+        vec3f intensities;
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const auto normal = mesh.normals[mesh.normalIndices[first + i]];
+            if (dot(normal, normal) == 0.f)
+                return FlatVertexShader{ lightVector }(mesh, first);
+
+            intensities[i] = -dot(lightVector, normalize(normal));
+        }
+        return intensities;
+    }
+};
+
+// For fragment shaders that light every pixel themselves.
+struct UnlitVertexShader
+{
+    vec3f operator()(const MeshView&, const size_t) const
+    {
+        return vec3f{ 1.f, 1.f, 1.f };
+    }
+};
+
+struct FlatFragmentShader
+{
+    static constexpr bool writes_color = true;
+    static constexpr uint64_t texture_fetches = 1;
+
+    template <typename TextureLookup>
+    auto ForTriangle(const ScreenTriangle& triangle, const TextureLookup& lookup) const
+    {
+        return [intensity = triangle.intensities[0], lookup](const vec3f& barycentric) {
+            return ShadedFragment{ intensity, lookup(barycentric) };
+        };
+    }
+};
+
+struct GouraudFragmentShader
+{
+    static constexpr bool writes_color = true;
+    static constexpr uint64_t texture_fetches = 1;
+
+    template <typename TextureLookup>
+    auto ForTriangle(const ScreenTriangle& triangle, const TextureLookup& lookup) const
+    {
+        return [intensities = triangle.intensities, lookup](const vec3f& barycentric) {
+            return ShadedFragment{ dot(intensities, barycentric), lookup(barycentric) };
+        };
+    }
+};
+
+// Object space normal map laid out like the diffuse texture, with each
+// channel mapping [0, 255] to [-1, 1].
+struct NormalMappedFragmentShader
+{
+    static constexpr bool writes_color = true;
+    static constexpr uint64_t texture_fetches = 2;
+
+    const Texture& normalMap;
+    vec3f lightVector;
+
+    template <typename TextureLookup>
+    auto ForTriangle(const ScreenTriangle& triangle, const TextureLookup& lookup) const
+    {
+        const auto level = normalMap.SelectLevel(triangle.triangle, triangle.textureCoordinates);
+        return [this, &triangle, level, lookup](const vec3f& barycentric) {
+            const auto texel = normalMap.Sample(barycentric, triangle.textureCoordinates, level);
+            const vec3f normal{ texel.r / 127.5f - 1.f, texel.g / 127.5f - 1.f, texel.b / 127.5f - 1.f };
+            return ShadedFragment{ -dot(lightVector, normalize(normal)), lookup(barycentric) };
+        };
+    }
+};
+
+// Fills only the z-buffer, for example as a prepass.
+struct DepthOnlyFragmentShader
+{
+    static constexpr bool writes_color = false;
+    static constexpr uint64_t texture_fetches = 0;
+};
@@ -2,8 +2,222 @@
 #include "catch.hpp"
 
 #include "../renderer.hpp"
+#include "../tgaimpl.hpp"
+#include "../objimpl.hpp"
+#include "../objparser.hpp"
+#include "../binarymesh.hpp"
+#include "../meshlod.hpp"
+#include "../meshorder.hpp"
+#include "../batch.hpp"
+#include "../sequence.hpp"
+#include "../tgacodec.hpp"
+#include "../framestream.hpp"
+#include "../framebuffer.hpp"
 #include "../hola/hola.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <thread>
+
+namespace
+{
+    std::atomic<size_t> heap_allocations{ 0 };
+}
+
+void* operator new(const std::size_t size)
+{
+    ++heap_allocations;
+    if (const auto memory = std::malloc(size != 0 ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size) { return operator new(size); }
+
+// Kept out of line: once inlined next to the matching new, GCC takes the
+// free for a mismatched deallocation.
+[[gnu::noinline]] void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { operator delete(memory); }
+void operator delete[](void* memory) noexcept { operator delete(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { operator delete(memory); }
+
+namespace
+{
+    class TestModel : public IModel
+    {
+        Mesh m_mesh;
+    public:
+        TestModel(const std::vector<TriangulatePolygon>& polygons)
+        {
+            for (const auto& polygon : polygons)
+            {
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    m_mesh.positionIndices.push_back(static_cast<uint32_t>(m_mesh.positions.size()));
+                    m_mesh.textureIndices.push_back(static_cast<uint32_t>(m_mesh.textureCoords.size()));
+                    m_mesh.normalIndices.push_back(0);
+                    m_mesh.positions.push_back(polygon.vertices[i]);
+                    m_mesh.textureCoords.push_back(polygon.textureCoordinates[i]);
+                }
+            }
+            m_mesh.normals.push_back(vec3f{ 0.f, 0.f, 0.f });
+        }
+
+        // Same, with normals for each corner of each polygon.
+        TestModel(const std::vector<TriangulatePolygon>& polygons, const std::vector<Vertices>& normals)
+            : TestModel(polygons)
+        {
+            m_mesh.normalIndices.clear();
+            for (const auto& corners : normals)
+            {
+                for (const auto& normal : corners)
+                {
+                    m_mesh.normalIndices.push_back(static_cast<uint32_t>(m_mesh.normals.size()));
+                    m_mesh.normals.push_back(normal);
+                }
+            }
+        }
+
+        explicit TestModel(Mesh mesh) : m_mesh(std::move(mesh)) {}
+
+        virtual void ReadModel(const std::filesystem::path&) override {}
+        virtual MeshView GetMesh() const override { return m_mesh.View(); }
+    };
+
+    // Square of cells x cells quads sharing their corners, facing the
+    // viewer, raised into waves of the given height.
+    Mesh WavyGrid(const uint32_t cells, const float_t wave_height)
+    {
+        Mesh mesh;
+        for (uint32_t y = 0; y <= cells; ++y)
+        {
+            for (uint32_t x = 0; x <= cells; ++x)
+            {
+                const auto u = static_cast<float_t>(x) / cells;
+                const auto v = static_cast<float_t>(y) / cells;
+                mesh.positions.push_back(vec3f{ 1.8f * u - .9f, 1.8f * v - .9f, wave_height * std::sin(12.f * u) * std::cos(9.f * v) });
+                mesh.textureCoords.push_back(vec2f{ u, v });
+            }
+        }
+        mesh.normals.push_back(vec3f{ 0.f, 0.f, 0.f });
+
+        const auto vertex = [cells](const uint32_t x, const uint32_t y) { return y * (cells + 1) + x; };
+        for (uint32_t y = 0; y < cells; ++y)
+        {
+            for (uint32_t x = 0; x < cells; ++x)
+            {
+                for (const auto corner : { vertex(x, y), vertex(x, y + 1), vertex(x + 1, y + 1),
+                    vertex(x, y), vertex(x + 1, y + 1), vertex(x + 1, y) })
+                {
+                    mesh.positionIndices.push_back(corner);
+                    mesh.textureIndices.push_back(corner);
+                    mesh.normalIndices.push_back(0);
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // Same triangles in random order, like a scattered export.
+    Mesh ShuffleTriangles(Mesh mesh, const uint32_t seed)
+    {
+        std::vector<size_t> order(mesh.TriangleCount());
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+        Mesh shuffled = mesh;
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                shuffled.positionIndices[i * 3 + k] = mesh.positionIndices[order[i] * 3 + k];
+                shuffled.textureIndices[i * 3 + k] = mesh.textureIndices[order[i] * 3 + k];
+                shuffled.normalIndices[i * 3 + k] = mesh.normalIndices[order[i] * 3 + k];
+            }
+        }
+        return shuffled;
+    }
+
+    std::vector<TriangulatePolygon> RandomPolygons(const size_t count, const uint32_t seed)
+    {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<float> pos(-1.2f, 1.2f);
+        std::uniform_real_distribution<float> uv(0.f, 1.f);
+
+        std::vector<TriangulatePolygon> polygons(count);
+        for (auto& polygon : polygons)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                polygon.vertices[i] = vec3f{ pos(gen), pos(gen), pos(gen) };
+                polygon.textureCoordinates[i] = vec2f{ uv(gen), uv(gen) };
+            }
+        }
+        return polygons;
+    }
+
+    TgaImage CheckerTexture(const Width width, const Height height)
+    {
+        TgaImage texture;
+        texture.CreateImage(width, height);
+        for (int32_t y = 0; y < static_cast<int32_t>(height); ++y)
+        {
+            for (int32_t x = 0; x < static_cast<int32_t>(width); ++x)
+            {
+                const auto v = static_cast<uint8_t>(((x / 8 + y / 8) % 2) ? 255 : 64);
+                texture.SetPixelColor(x, y, 1.f, TgaColor{ v, static_cast<uint8_t>(x * 4), static_cast<uint8_t>(y * 4) });
+            }
+        }
+        return texture;
+    }
+
+    template <typename T>
+    bool ArraysEqual(const ArrayView<T>& lhs, const ArrayView<T>& rhs)
+    {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    bool MeshesEqual(const MeshView& lhs, const MeshView& rhs)
+    {
+        return ArraysEqual(lhs.positions, rhs.positions)
+            && ArraysEqual(lhs.textureCoords, rhs.textureCoords)
+            && ArraysEqual(lhs.normals, rhs.normals)
+            && ArraysEqual(lhs.positionIndices, rhs.positionIndices)
+            && ArraysEqual(lhs.textureIndices, rhs.textureIndices)
+            && ArraysEqual(lhs.normalIndices, rhs.normalIndices);
+    }
+
+    std::string ReadFile(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    }
+
+    bool ImagesEqual(const IImg& lhs, const IImg& rhs)
+    {
+        if (lhs.GetImageSize() != rhs.GetImageSize())
+            return false;
+
+        const auto[width, height] = lhs.GetImageSize();
+        for (int32_t y = 0; y < static_cast<int32_t>(height); ++y)
+        {
+            for (int32_t x = 0; x < static_cast<int32_t>(width); ++x)
+            {
+                const auto l = lhs.GetPixelColor(x, y)->ToRgba();
+                const auto r = rhs.GetPixelColor(x, y)->ToRgba();
+                if (l.r != r.r || l.g != r.g || l.b != r.b || l.a != r.a)
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
 SCENARIO("Bounding box calculation", "[renderer]")
 {
     Renderer renderer;
@@ -124,3 +338,1777 @@ SCENARIO("Calculating point barycentric coordinates in relation to triangle", "[
         }
     }
 }
+
+SCENARIO("Rendering model with multiple threads", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    GIVEN("model with many overlapping triangles")
+    {
+        const TestModel model{ RandomPolygons(500, 42) };
+        WHEN("rendering it single-threaded and tile-binned on several threads")
+        {
+            TgaImage single_threaded;
+            single_threaded.CreateImage(301, 199);
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            renderer.RenderModel(model, texture, single_threaded);
+
+            TgaImage multi_threaded;
+            multi_threaded.CreateImage(301, 199);
+            renderer.SetThreadCount(4);
+            renderer.RenderModel(model, texture, multi_threaded);
+
+            THEN("both images are identical")
+            {
+                REQUIRE(ImagesEqual(single_threaded, multi_threaded));
+            }
+        }
+    }
+}
+
+SCENARIO("Edge function rasterization", "[rasterizer]")
+{
+    Renderer renderer;
+    const BoundingBox screen{ vec2f{ 0.f, 0.f }, vec2f{ 127.f, 127.f } };
+    const auto covered_pixels = [&screen](const Triangle& triangle) {
+        std::vector<int> coverage(128 * 128, 0);
+        if (const auto setup = SetupTriangle(triangle))
+        {
+            Rasterize(*setup, screen, [&coverage](const int32_t x, const int32_t y, const vec3f&) {
+                ++coverage[x + y * 128];
+            });
+        }
+        return coverage;
+    };
+
+    GIVEN("random triangles with pixel aligned vertices")
+    {
+        std::mt19937 gen(7);
+        std::uniform_int_distribution<int> coord(-10, 137);
+        std::vector<Triangle> triangles(200);
+        for (auto& triangle : triangles)
+        {
+            for (auto& vertex : triangle)
+            {
+                vertex = vec3f{ static_cast<float>(coord(gen)), static_cast<float>(coord(gen)), 0.f };
+            }
+        }
+
+        THEN("coverage matches barycentric inside test except on the edges")
+        {
+            constexpr float eps = 1e-4f;
+            size_t mismatches = 0;
+            for (const auto& triangle : triangles)
+            {
+                const auto coverage = covered_pixels(triangle);
+                for (int y = 0; y < 128; ++y)
+                {
+                    for (int x = 0; x < 128; ++x)
+                    {
+                        const auto bar = renderer.CalculateBarycentric(
+                            { static_cast<float>(x), static_cast<float>(y), 0.f }, triangle);
+                        if (!bar)
+                            continue;
+
+                        const auto min_weight = std::min({ get_x(*bar), get_y(*bar), get_z(*bar) });
+                        if (min_weight > eps && coverage[x + y * 128] != 1)
+                            ++mismatches;
+                        if (min_weight < -eps && coverage[x + y * 128] != 0)
+                            ++mismatches;
+                    }
+                }
+            }
+            REQUIRE(mismatches == 0);
+        }
+    }
+
+    GIVEN("triangle fan sharing edges and a center vertex")
+    {
+        const std::array<vec3f, 6> outline = { {
+            { 10.f, 10.f, 0.f }, { 64.f, 4.f, 0.f }, { 120.f, 30.f, 0.f },
+            { 110.f, 120.f, 0.f }, { 40.f, 100.f, 0.f }, { 4.f, 60.f, 0.f } } };
+        const vec3f center{ 60.f, 60.f, 0.f };
+
+        std::vector<int> total(128 * 128, 0);
+        for (size_t i = 0; i < outline.size(); ++i)
+        {
+            const auto coverage = covered_pixels({ center, outline[i], outline[(i + 1) % outline.size()] });
+            for (size_t p = 0; p < total.size(); ++p)
+            {
+                total[p] += coverage[p];
+            }
+        }
+
+        THEN("no pixel is drawn twice and the center is drawn once")
+        {
+            REQUIRE(*std::max_element(total.begin(), total.end()) == 1);
+            REQUIRE(total[60 + 60 * 128] == 1);
+        }
+    }
+
+    GIVEN("long diagonal slivers reaching far from their first vertex")
+    {
+        THEN("depth of every covered pixel stays within the HiZ bound")
+        {
+            size_t fragments = 0;
+            for (const auto length : { 1000.f, 16000.f, 30000.f })
+            {
+                const Triangle triangle = { {
+                    { .5f, .25f, .5f }, { length, length - 1.3f, 1.f }, { length - .7f, length + .1f, 1.f } } };
+                const auto setup = SetupTriangle(triangle);
+                REQUIRE(setup);
+                const auto bound = DepthBound(*setup);
+                const BoundingBox far_end{ vec2f{ length - 200.f, length - 200.f }, vec2f{ length, length } };
+                Rasterize(*setup, far_end, [&](const int32_t, const int32_t, const vec3f& barycentric) {
+                    ++fragments;
+                    REQUIRE(InterpolateDepth(*setup, barycentric) <= bound);
+                });
+            }
+            REQUIRE(fragments > 0);
+        }
+    }
+
+    GIVEN("degenerate triangle")
+    {
+        const Triangle triangle = { {{10.f,10.f}, {20.f,10.f}, {30.f,10.f}} };
+        THEN("setup is rejected")
+        {
+            REQUIRE(SetupTriangle(triangle) == std::nullopt);
+        }
+    }
+}
+
+SCENARIO("Rendering with SIMD fragment kernels", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    GIVEN("model with many overlapping triangles")
+    {
+        const TestModel model{ RandomPolygons(500, 1234) };
+        WHEN("rendering it with scalar and every supported SIMD kernel")
+        {
+            TgaImage scalar;
+            scalar.CreateImage(257, 203);
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            renderer.SetSimdLevel(SimdLevel::Scalar);
+            renderer.RenderModel(model, texture, scalar);
+
+            THEN("images are identical")
+            {
+                for (const auto level : { SimdLevel::Sse2, SimdLevel::Avx2 })
+                {
+                    TgaImage simd;
+                    simd.CreateImage(257, 203);
+                    renderer.SetSimdLevel(level);
+                    renderer.RenderModel(model, texture, simd);
+                    REQUIRE(ImagesEqual(scalar, simd));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Rejecting occluded triangles with hierarchical z-buffer", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    GIVEN("screen-filling occluder drawn before many triangles behind it")
+    {
+        auto polygons = RandomPolygons(500, 7);
+        TriangulatePolygon lower;
+        lower.vertices = { vec3f{ -1.f, -1.f, 1.f }, vec3f{ 1.f, -1.f, 1.f }, vec3f{ 1.f, 1.f, 1.f } };
+        lower.textureCoordinates = { vec2f{ 0.f, 0.f }, vec2f{ 1.f, 0.f }, vec2f{ 1.f, 1.f } };
+        TriangulatePolygon upper;
+        upper.vertices = { vec3f{ -1.f, -1.f, 1.f }, vec3f{ 1.f, 1.f, 1.f }, vec3f{ -1.f, 1.f, 1.f } };
+        upper.textureCoordinates = { vec2f{ 0.f, 0.f }, vec2f{ 1.f, 1.f }, vec2f{ 0.f, 1.f } };
+        polygons.insert(polygons.begin(), { lower, upper });
+        const TestModel model{ polygons };
+
+        WHEN("rendering it with and without hierarchical z-buffer")
+        {
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+
+            TgaImage with_hiz;
+            with_hiz.CreateImage(203, 157);
+            renderer.RenderModel(model, texture, with_hiz);
+            const auto stats = renderer.GetHiZStats();
+
+            TgaImage without_hiz;
+            without_hiz.CreateImage(203, 157);
+            renderer.SetHierarchicalZ(false);
+            renderer.RenderModel(model, texture, without_hiz);
+
+            THEN("images are identical and occluded triangles are rejected")
+            {
+                REQUIRE(ImagesEqual(with_hiz, without_hiz));
+                REQUIRE(stats.trianglesRejected > 0);
+                REQUIRE(stats.blocksRejected >= stats.trianglesRejected);
+                REQUIRE(stats.blocksTested > stats.blocksRejected);
+            }
+        }
+    }
+}
+
+SCENARIO("Rendering with deferred shading", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    GIVEN("model with many overlapping triangles")
+    {
+        const TestModel model{ RandomPolygons(500, 99) };
+        WHEN("rendering it forward and through the visibility buffer")
+        {
+            TgaImage forward;
+            forward.CreateImage(233, 181);
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            renderer.RenderModel(model, texture, forward);
+
+            THEN("images are identical for one and many threads")
+            {
+                renderer.SetDeferredShading(true);
+                for (const auto threads : { 1u, 4u })
+                {
+                    TgaImage deferred;
+                    deferred.CreateImage(233, 181);
+                    renderer.SetThreadCount(threads);
+                    renderer.RenderModel(model, texture, deferred);
+                    REQUIRE(ImagesEqual(forward, deferred));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Rendering into a reused framebuffer", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    const Texture mipmapped(std::as_const(texture).GetPixels(), true);
+    GIVEN("model with many overlapping triangles")
+    {
+        const TestModel model{ RandomPolygons(500, 23) };
+        TgaImage reference;
+        reference.CreateImage(257, 190);
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+        renderer.RenderModel(model, mipmapped, reference);
+
+        FrameBuffer frame;
+        frame.CreateImage(257, 190);
+
+        WHEN("rendering frame after frame")
+        {
+            for (const auto threads : { 1u, 4u })
+            {
+                for (const auto deferred : { false, true })
+                {
+                    renderer.SetThreadCount(threads);
+                    renderer.SetDeferredShading(deferred);
+                    renderer.RenderModel(model, mipmapped, frame);
+                    frame.Clear();
+
+                    const auto before = heap_allocations.load();
+                    renderer.RenderModel(model, mipmapped, frame);
+                    const auto allocations = heap_allocations - before;
+
+                    DYNAMIC_SECTION("Then: steady state frames don't allocate and match a plain image on "
+                        << threads << " threads" << (deferred ? " with deferred shading" : ""))
+                    {
+                        REQUIRE(allocations == 0);
+                        REQUIRE(ImagesEqual(reference, frame));
+                    }
+                }
+            }
+        }
+
+        WHEN("rendering on several threads")
+        {
+            renderer.SetThreadCount(4);
+            renderer.RenderModel(model, mipmapped, frame);
+
+            THEN("frame matches a plain image")
+            {
+                REQUIRE(ImagesEqual(reference, frame));
+            }
+        }
+
+        WHEN("rendering into it again without clearing")
+        {
+            renderer.RenderModel(model, mipmapped, frame);
+            const auto rgba = RGBA{ 10, 20, 30, 255 };
+            frame.ClearColor(rgba);
+            renderer.RenderModel(model, mipmapped, frame);
+
+            THEN("depth from the first render hides every fragment")
+            {
+                const auto pixels = std::as_const(frame).GetPixels();
+                for (int32_t y = 0; y < 190; ++y)
+                {
+                    for (int32_t x = 0; x < 257; ++x)
+                    {
+                        const auto color = pixels.Get(x, y);
+                        REQUIRE((color.r == rgba.r && color.g == rgba.g && color.b == rgba.b));
+                    }
+                }
+            }
+        }
+
+        WHEN("clearing to a color and resizing")
+        {
+            frame.CreateImage(33, 17);
+            frame.ClearColor(RGBA{ 1, 2, 3, 4 });
+
+            THEN("every pixel has that color and depth is cleared")
+            {
+                REQUIRE(frame.GetImageSize() == ImageSize{ 33, 17 });
+                const auto color = std::as_const(frame).GetPixels().Get(32, 16);
+                REQUIRE((color.r == 1 && color.g == 2 && color.b == 3));
+                REQUIRE(frame.GetPixelColor(5, 5)->ToRgba().b == 3);
+                REQUIRE(frame.Depth().GetSize() == ImageSize{ 33, 17 });
+                REQUIRE(frame.Depth().Get(32, 16) == Float32Depth::clear);
+            }
+        }
+    }
+}
+
+SCENARIO("Rendering with reduced precision and compressed depth", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    const Texture sampled(std::as_const(texture).GetPixels());
+    const auto render = [&sampled](Renderer& renderer, const IModel& model) {
+        TgaImage image;
+        image.CreateImage(257, 190);
+        renderer.RenderModel(model, sampled, image);
+        return image;
+    };
+    const auto differing_pixels = [](const IImg& lhs, const IImg& rhs) {
+        const auto[width, height] = lhs.GetImageSize();
+        size_t count = 0;
+        for (int32_t y = 0; y < static_cast<int32_t>(height); ++y)
+        {
+            for (int32_t x = 0; x < static_cast<int32_t>(width); ++x)
+            {
+                const auto l = lhs.GetPixelColor(x, y)->ToRgba();
+                const auto r = rhs.GetPixelColor(x, y)->ToRgba();
+                count += l.r != r.r || l.g != r.g || l.b != r.b;
+            }
+        }
+        return count;
+    };
+
+    GIVEN("model with many overlapping triangles")
+    {
+        const TestModel model{ RandomPolygons(500, 23) };
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+        const auto reference = render(renderer, model);
+
+        WHEN("depth is compressed")
+        {
+            renderer.SetDepthFormat(DepthFormat::Compressed);
+
+            THEN("every way of rendering matches float depth exactly")
+            {
+                REQUIRE(ImagesEqual(reference, render(renderer, model)));
+                renderer.SetDeferredShading(true);
+                REQUIRE(ImagesEqual(reference, render(renderer, model)));
+                renderer.SetThreadCount(4);
+                REQUIRE(ImagesEqual(reference, render(renderer, model)));
+                renderer.SetHierarchicalZ(false);
+                REQUIRE(ImagesEqual(reference, render(renderer, model)));
+            }
+        }
+
+        WHEN("depth is stored in 16 or 24 bits")
+        {
+            const std::vector<std::pair<DepthFormat, std::string>> formats{
+                { DepthFormat::Unorm16, "16" }, { DepthFormat::Unorm24, "24" } };
+            for (const auto& [format, name] : formats)
+            {
+                renderer.SetDepthFormat(format);
+                renderer.SetThreadCount(1);
+                const auto image = render(renderer, model);
+                renderer.SetThreadCount(4);
+                renderer.SetSimdLevel(SimdLevel::Scalar);
+                const auto scalar = render(renderer, model);
+                renderer.SetSimdLevel(SimdLevel::Avx2);
+
+                DYNAMIC_SECTION("Then: only a few near ties resolve differently and every kernel agrees with "
+                    << name << " bit depth")
+                {
+                    REQUIRE(differing_pixels(reference, image) < 257 * 190 / 100);
+                    REQUIRE(ImagesEqual(image, scalar));
+                }
+            }
+        }
+    }
+
+    GIVEN("screen filling quads close to each other in depth")
+    {
+        const auto quad = [](const float_t z, const float_t u) {
+            const auto corner = [z](const float_t x, const float_t y) { return vec3f{ x, y, z }; };
+            std::vector<TriangulatePolygon> polygons(2);
+            polygons[0].vertices = { corner(-1.f, -1.f), corner(1.f, -1.f), corner(1.f, 1.f) };
+            polygons[1].vertices = { corner(-1.f, -1.f), corner(1.f, 1.f), corner(-1.f, 1.f) };
+            for (auto& polygon : polygons)
+                polygon.textureCoordinates = { vec2f{ u, u }, vec2f{ u, u }, vec2f{ u, u } };
+            return polygons;
+        };
+        auto back_to_front = quad(.1f, .1f);
+        const auto near = quad(.1005f, .6f);
+        back_to_front.insert(back_to_front.end(), near.begin(), near.end());
+        std::vector<TriangulatePolygon> front_to_back(back_to_front.rbegin(), back_to_front.rend());
+        Renderer reference_renderer;
+        reference_renderer.SetLightVector({ 0, 0, -1 });
+        TgaImage near_only;
+        near_only.CreateImage(256, 192);
+        reference_renderer.RenderModel(TestModel{ near }, sampled, near_only);
+
+        WHEN("rendering into framebuffers of every format")
+        {
+            std::vector<std::pair<DepthFormat, size_t>> memory;
+            const std::vector<std::pair<DepthFormat, std::string>> formats{
+                { DepthFormat::Float32, "float" },
+                { DepthFormat::Unorm16, "16 bit" },
+                { DepthFormat::Unorm24, "24 bit" },
+                { DepthFormat::Compressed, "compressed" } };
+            for (const auto& [format, name] : formats)
+            {
+                FrameBuffer frame;
+                frame.SetDepthFormat(format);
+                frame.CreateImage(256, 192);
+                Renderer renderer;
+                renderer.SetLightVector({ 0, 0, -1 });
+                renderer.RenderModel(TestModel{ back_to_front }, sampled, frame);
+                FrameBuffer reversed;
+                reversed.SetDepthFormat(format);
+                reversed.CreateImage(256, 192);
+                renderer.RenderModel(TestModel{ front_to_back }, sampled, reversed);
+                memory.emplace_back(format, frame.Depth().MemoryBytes());
+
+                DYNAMIC_SECTION("Then: the nearer quad wins in either order with " << name << " depth")
+                {
+                    REQUIRE(ImagesEqual(near_only, frame));
+                    REQUIRE(ImagesEqual(near_only, reversed));
+                }
+            }
+
+            THEN("depth memory shrinks with the format")
+            {
+                const auto float_bytes = memory[0].second;
+                REQUIRE(float_bytes == 256 * 192 * sizeof(float_t));
+                REQUIRE(memory[1].second == float_bytes / 2);
+                REQUIRE(memory[2].second == float_bytes * 3 / 4);
+                REQUIRE(memory[3].second < float_bytes / 2);
+            }
+        }
+    }
+}
+
+SCENARIO("Rendering in bands", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    const Texture sampled(std::as_const(texture).GetPixels(), true);
+    const auto path = std::filesystem::temp_directory_path() / "renderer_tests_bands.ppm";
+
+    GIVEN("model with many triangles, some reaching off screen")
+    {
+        const TestModel model{ RandomPolygons(500, 29) };
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+        TgaImage reference;
+        reference.CreateImage(233, 181);
+        renderer.RenderModel(model, sampled, reference);
+
+        // Copies bands back into one picture, checking they arrive top first.
+        const auto render_in_bands = [&](const Height band_height, FrameBuffer& band) {
+            TgaImage image;
+            image.CreateImage(233, 181);
+            auto top = Height{ 181 };
+            bool in_order = true;
+            renderer.RenderModelInBands(model, sampled, ImageSize{ 233, 181 }, band_height, band,
+                [&](const ConstPixelView& pixels) {
+                    in_order = in_order && pixels.width == 233 && pixels.height <= band_height && pixels.height <= top;
+                    top -= std::min(top, pixels.height);
+                    const auto row_bytes = pixels.width * pixels.bytesPerPixel;
+                    std::copy(pixels.data, pixels.data + pixels.height * row_bytes,
+                        image.GetPixels().data + top * row_bytes);
+                });
+            REQUIRE(in_order);
+            REQUIRE(top == 0);
+            return image;
+        };
+
+        WHEN("bands are rendered every way")
+        {
+            THEN("they add up to the full render")
+            {
+                for (const auto format : { DepthFormat::Float32, DepthFormat::Compressed })
+                {
+                    FrameBuffer band;
+                    band.SetDepthFormat(format);
+                    for (const Height band_height : { 1, 7, 64, 181, 1000 })
+                    {
+                        renderer.SetDeferredShading(false);
+                        renderer.SetThreadCount(1);
+                        REQUIRE(ImagesEqual(reference, render_in_bands(band_height, band)));
+                        renderer.SetThreadCount(4);
+                        REQUIRE(ImagesEqual(reference, render_in_bands(band_height, band)));
+                        renderer.SetDeferredShading(true);
+                        REQUIRE(ImagesEqual(reference, render_in_bands(band_height, band)));
+                    }
+                    REQUIRE(band.GetImageSize() == ImageSize{ 233, 181 });
+                }
+            }
+        }
+
+        WHEN("bands are streamed into a PPM file")
+        {
+            {
+                FrameBuffer band;
+                FrameStream stream(path, OutputFormat::Ppm);
+                stream.BeginFrame(233, 181);
+                renderer.RenderModelInBands(model, sampled, ImageSize{ 233, 181 }, 16, band,
+                    [&stream](const ConstPixelView& pixels) { stream.WriteBand(pixels); });
+                REQUIRE(band.GetImageSize() == ImageSize{ 233, 5 });
+            }
+            const auto banded = ReadFile(path);
+            {
+                FrameStream stream(path, OutputFormat::Ppm);
+                stream.Write(std::as_const(reference).GetPixels());
+            }
+
+            THEN("the file matches the full image written at once")
+            {
+                REQUIRE(banded == ReadFile(path));
+            }
+        }
+
+        WHEN("a band doesn't fit the frame being streamed")
+        {
+            FrameBuffer band;
+            band.CreateImage(233, 16);
+            FrameStream stream(path, OutputFormat::Rgb);
+            stream.BeginFrame(233, 10);
+
+            THEN("it is refused")
+            {
+                REQUIRE_THROWS(stream.WriteBand(std::as_const(band).GetPixels()));
+            }
+        }
+        std::filesystem::remove(path);
+    }
+
+    GIVEN("picture wider than a TGA header can describe")
+    {
+        FrameBuffer wide;
+        wide.CreateImage(65536, 1);
+        const auto tga_path = std::filesystem::temp_directory_path() / "renderer_tests_wide.tga";
+        std::filesystem::remove(tga_path);
+        THEN("writing it as TGA is refused before creating the file")
+        {
+            REQUIRE_THROWS(WriteTga(std::as_const(wide).GetPixels(), tga_path));
+            REQUIRE(!std::filesystem::exists(tga_path));
+        }
+    }
+}
+
+SCENARIO("Rendering with multisample anti-aliasing", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    const Texture sampled(std::as_const(texture).GetPixels());
+    const auto render = [&sampled](Renderer& renderer, const IModel& model, const uint32_t samples) {
+        TgaImage image;
+        image.CreateImage(97, 83);
+        renderer.SetSampleCount(samples);
+        renderer.RenderModel(model, sampled, image);
+        return image;
+    };
+
+    GIVEN("quad of one colour reaching past the screen")
+    {
+        const auto corner = [](const float_t x, const float_t y) { return vec3f{ x, y, .5f }; };
+        std::vector<TriangulatePolygon> polygons(2);
+        polygons[0].vertices = { corner(-1.2f, -1.2f), corner(1.2f, -1.2f), corner(1.2f, 1.2f) };
+        polygons[1].vertices = { corner(-1.2f, -1.2f), corner(1.2f, 1.2f), corner(-1.2f, 1.2f) };
+        for (auto& polygon : polygons)
+            polygon.textureCoordinates = { vec2f{ .3f, .3f }, vec2f{ .3f, .3f }, vec2f{ .3f, .3f } };
+        const TestModel model{ polygons };
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+        const auto single = render(renderer, model, 1);
+
+        THEN("the shared edge leaves no trace and every pixel matches single sampling")
+        {
+            REQUIRE(ImagesEqual(single, render(renderer, model, 4)));
+            REQUIRE(ImagesEqual(single, render(renderer, model, 8)));
+        }
+    }
+
+    GIVEN("single triangle on a black background")
+    {
+        std::vector<TriangulatePolygon> polygons(1);
+        polygons[0].vertices = { vec3f{ -.9f, -.8f, .5f }, vec3f{ .85f, -.3f, .5f }, vec3f{ -.2f, .9f, .5f } };
+        polygons[0].textureCoordinates = { vec2f{ .3f, .3f }, vec2f{ .3f, .3f }, vec2f{ .3f, .3f } };
+        const TestModel model{ polygons };
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+        const auto single = render(renderer, model, 1);
+        const auto full = single.GetPixels().Get(40, 40);
+
+        for (const uint32_t samples : { 4u, 8u })
+        {
+            const auto multisampled = render(renderer, model, samples);
+            size_t partial = 0;
+            size_t changed_inside = 0;
+            for (int32_t y = 0; y < 83; ++y)
+            {
+                for (int32_t x = 0; x < 97; ++x)
+                {
+                    const auto before = single.GetPixels().Get(x, y);
+                    const auto after = multisampled.GetPixels().Get(x, y);
+                    partial += after.g > 0 && after.g < full.g;
+                    const auto inside = [&](const int32_t nx, const int32_t ny) {
+                        return single.GetPixels().Get(nx, ny).g == full.g;
+                    };
+                    changed_inside += inside(x, y) && inside(x - 1, y) && inside(x + 1, y)
+                        && inside(x, y - 1) && inside(x, y + 1) && after.g != before.g;
+                }
+            }
+
+            DYNAMIC_SECTION("Then: edge pixels blend with the background and inner ones are left as they were with "
+                << samples << " samples")
+            {
+                REQUIRE(partial > 50);
+                REQUIRE(changed_inside == 0);
+            }
+        }
+    }
+
+    GIVEN("model with many overlapping triangles")
+    {
+        const TestModel model{ RandomPolygons(300, 31) };
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+        renderer.SetStatsEnabled(true);
+        const auto reference = render(renderer, model, 4);
+        const auto stats = renderer.GetStats();
+
+        THEN("pixels are shaded once however many samples they cover")
+        {
+            REQUIRE(stats.depthPassed > 0);
+            REQUIRE(stats.textureFetches == stats.depthPassed);
+        }
+
+        THEN("threads, deferred shading and bands give the same picture")
+        {
+            renderer.SetThreadCount(4);
+            REQUIRE(ImagesEqual(reference, render(renderer, model, 4)));
+            renderer.SetDeferredShading(true);
+            REQUIRE(ImagesEqual(reference, render(renderer, model, 4)));
+
+            TgaImage banded;
+            banded.CreateImage(97, 83);
+            FrameBuffer band;
+            auto top = Height{ 83 };
+            renderer.RenderModelInBands(model, sampled, ImageSize{ 97, 83 }, 10, band, [&](const ConstPixelView& pixels) {
+                top -= pixels.height;
+                const auto row_bytes = pixels.width * pixels.bytesPerPixel;
+                std::copy(pixels.data, pixels.data + pixels.height * row_bytes, banded.GetPixels().data + top * row_bytes);
+            });
+            REQUIRE(ImagesEqual(reference, banded));
+        }
+    }
+}
+
+SCENARIO("Culling and clipping triangles", "[renderer]")
+{
+    auto texture = CheckerTexture(1, 1);
+    const auto triangle = [](const vec3f& a, const vec3f& b, const vec3f& c) {
+        TriangulatePolygon polygon;
+        polygon.vertices = { a, b, c };
+        polygon.textureCoordinates = { vec2f{ .5f, .5f }, vec2f{ .5f, .5f }, vec2f{ .5f, .5f } };
+        return polygon;
+    };
+    const auto quad = [&triangle](const float_t size, const float_t z_left, const float_t z_right) {
+        return std::vector<TriangulatePolygon>{
+            triangle({ -size, -size, z_left }, { size, -size, z_right }, { size, size, z_right }),
+            triangle({ -size, -size, z_left }, { size, size, z_right }, { -size, size, z_left }) };
+    };
+    const auto render = [&texture](Renderer& renderer, const std::vector<TriangulatePolygon>& polygons) {
+        TgaImage image;
+        image.CreateImage(64, 48);
+        renderer.ResetStats();
+        renderer.RenderModel(TestModel{ polygons }, texture, image);
+        return image;
+    };
+    const auto is_lit = [](const TgaImage& image, const int32_t x, const int32_t y) {
+        const auto color = image.GetPixelColor(x, y)->ToRgba();
+        return color.r != 0 || color.g != 0 || color.b != 0;
+    };
+
+    Renderer renderer;
+    renderer.SetLightVector({ 0, 0, -1 });
+    renderer.SetStatsEnabled(true);
+
+    GIVEN("quad reaching far beyond the guard band")
+    {
+        const auto huge = render(renderer, quad(400.f, 0.f, 0.f));
+        const auto stats = renderer.GetStats();
+
+        THEN("it is clipped and covers the image like a screen-sized quad")
+        {
+            REQUIRE(stats.trianglesClipped == 2);
+            REQUIRE(ImagesEqual(huge, render(renderer, quad(1.f, 0.f, 0.f))));
+            REQUIRE(renderer.GetStats().trianglesClipped == 0);
+        }
+    }
+
+    GIVEN("quad crossing the near plane")
+    {
+        const auto polygons = quad(1.f, 0.f, 2.f);
+        WHEN("rendering it with the default near plane")
+        {
+            const auto image = render(renderer, polygons);
+
+            THEN("only the part behind the plane is drawn")
+            {
+                REQUIRE(renderer.GetStats().trianglesClipped == 2);
+                REQUIRE(is_lit(image, 8, 24));
+                REQUIRE(!is_lit(image, 56, 24));
+            }
+        }
+        WHEN("moving the near plane in front of it")
+        {
+            renderer.SetNearPlane(3.f);
+            const auto image = render(renderer, polygons);
+
+            THEN("all of it is drawn")
+            {
+                REQUIRE(renderer.GetStats().trianglesClipped == 0);
+                REQUIRE(is_lit(image, 8, 24));
+                REQUIRE(is_lit(image, 56, 24));
+            }
+        }
+    }
+
+    GIVEN("clockwise triangle lit from behind")
+    {
+        const std::vector<TriangulatePolygon> polygons{
+            triangle({ -1.f, -1.f, 0.f }, { 1.f, 1.f, 0.f }, { 1.f, -1.f, 0.f }) };
+        renderer.SetLightVector({ 0, 0, 1 });
+
+        THEN("it is culled regardless of lighting unless back-face culling is off")
+        {
+            REQUIRE(!is_lit(render(renderer, polygons), 48, 12));
+            REQUIRE(renderer.GetStats().trianglesBackFacing == 1);
+
+            renderer.SetBackFaceCulling(false);
+            REQUIRE(is_lit(render(renderer, polygons), 48, 12));
+            REQUIRE(renderer.GetStats().trianglesBackFacing == 0);
+        }
+    }
+
+    GIVEN("off-screen and zero-area triangles")
+    {
+        const std::vector<TriangulatePolygon> polygons{
+            triangle({ 2.f, -1.f, 0.f }, { 3.f, -1.f, 0.f }, { 3.f, 1.f, 0.f }),
+            triangle({ -1.f, -1.f, 0.f }, { 0.f, 0.f, 0.f }, { 1.f, 1.f, 0.f }) };
+        render(renderer, polygons);
+
+        THEN("both are culled")
+        {
+            REQUIRE(renderer.GetStats().trianglesCulled == 2);
+        }
+    }
+}
+
+SCENARIO("Rendering with shading models", "[renderer]")
+{
+    auto texture_image = CheckerTexture(1, 1);
+    const Texture texture(std::as_const(texture_image).GetPixels());
+    const auto corner = [](const float_t x, const float_t y) { return vec3f{ x, y, 0.f }; };
+    const vec2f uv{ .5f, .5f };
+    const std::vector<TriangulatePolygon> quad{
+        { { corner(-1.f, -1.f), corner(1.f, -1.f), corner(1.f, 1.f) }, { uv, uv, uv } },
+        { { corner(-1.f, -1.f), corner(1.f, 1.f), corner(-1.f, 1.f) }, { uv, uv, uv } } };
+    const vec3f facing{ 0.f, 0.f, 1.f };
+    const vec3f sideways{ 1.f, 0.f, 0.f };
+    // Normals turn away from the light from left to right.
+    const TestModel model{ quad, { { facing, sideways, sideways }, { facing, sideways, facing } } };
+
+    Renderer renderer;
+    renderer.SetLightVector({ 0, 0, -1 });
+    renderer.SetStatsEnabled(true);
+    const auto render = [&]() {
+        TgaImage image;
+        image.CreateImage(64, 48);
+        renderer.ResetStats();
+        renderer.RenderModel(model, texture, image);
+        return image;
+    };
+    const auto brightness = [](const TgaImage& image, const int32_t x) {
+        const auto color = image.GetPixelColor(x, 24)->ToRgba();
+        return color.r + color.g + color.b;
+    };
+
+    GIVEN("flat shading")
+    {
+        const auto image = render();
+        THEN("the face normal lights every pixel alike")
+        {
+            REQUIRE(brightness(image, 4) > 0);
+            REQUIRE(brightness(image, 4) == brightness(image, 60));
+        }
+    }
+
+    GIVEN("Gouraud shading")
+    {
+        renderer.SetShading(Shading::Gouraud);
+        const auto image = render();
+        THEN("intensity follows the vertex normals")
+        {
+            REQUIRE(brightness(image, 4) > brightness(image, 32));
+            REQUIRE(brightness(image, 32) > brightness(image, 60));
+        }
+    }
+
+    GIVEN("normal mapped shading")
+    {
+        renderer.SetShading(Shading::NormalMapped);
+        const auto shade_with = [&](const uint8_t z) {
+            TgaImage normals;
+            normals.CreateImage(1, 1);
+            normals.GetPixels().Set(0, 0, 1.f, RGBA{ 128, 128, z, 255 });
+            renderer.SetNormalMap(std::make_shared<const Texture>(std::as_const(normals).GetPixels()));
+            return render();
+        };
+
+        THEN("intensity comes from the normal map")
+        {
+            REQUIRE(brightness(shade_with(255), 32) > 0);
+            REQUIRE(brightness(shade_with(0), 32) == 0);
+            REQUIRE(renderer.GetStats().textureFetches == 2 * renderer.GetStats().depthPassed);
+        }
+
+        THEN("rendering without a normal map throws")
+        {
+            renderer.SetNormalMap(nullptr);
+            REQUIRE_THROWS(render());
+        }
+    }
+
+    GIVEN("depth-only shading")
+    {
+        renderer.SetShading(Shading::DepthOnly);
+        const auto image = render();
+        THEN("depth is tested but no color is written")
+        {
+            REQUIRE(renderer.GetStats().depthPassed == 64 * 48);
+            REQUIRE(renderer.GetStats().textureFetches == 0);
+            REQUIRE(brightness(image, 32) == 0);
+        }
+    }
+}
+
+SCENARIO("Collecting render statistics", "[renderer]")
+{
+    auto texture = CheckerTexture(64, 64);
+    GIVEN("model with many overlapping triangles")
+    {
+        const TestModel model{ RandomPolygons(500, 17) };
+        const auto render = [&](Renderer& renderer) {
+            TgaImage image;
+            image.CreateImage(211, 173);
+            renderer.ResetStats();
+            renderer.RenderModel(model, texture, image);
+            return renderer.GetStats();
+        };
+
+        WHEN("stats are disabled")
+        {
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            const auto stats = render(renderer);
+
+            THEN("nothing is counted")
+            {
+                REQUIRE(stats.trianglesSubmitted == 0);
+                REQUIRE(stats.pixelsTested == 0);
+                REQUIRE(stats.textureFetches == 0);
+            }
+        }
+
+        WHEN("stats are enabled")
+        {
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            renderer.SetHierarchicalZ(false);
+            renderer.SetSimdLevel(SimdLevel::Scalar);
+            renderer.SetStatsEnabled(true);
+            const auto stats = render(renderer);
+
+            THEN("counters are consistent")
+            {
+                REQUIRE(stats.trianglesSubmitted == 500);
+                REQUIRE(stats.trianglesBackFacing > 0);
+                REQUIRE(stats.trianglesBackFacing + stats.trianglesCulled < stats.trianglesSubmitted);
+                REQUIRE(stats.pixelsCovered > 0);
+                REQUIRE(stats.pixelsCovered <= stats.pixelsTested);
+                REQUIRE(stats.depthPassed + stats.depthFailed == stats.pixelsCovered);
+                REQUIRE(stats.depthFailed > 0);
+                REQUIRE(stats.textureFetches == stats.depthPassed);
+            }
+
+            THEN("SIMD kernels and threads count the same fragments")
+            {
+                const auto check = [&stats](const RenderStats& other) {
+                    REQUIRE(other.trianglesCulled == stats.trianglesCulled);
+                    REQUIRE(other.pixelsTested == stats.pixelsTested);
+                    REQUIRE(other.pixelsCovered == stats.pixelsCovered);
+                    REQUIRE(other.depthPassed == stats.depthPassed);
+                    REQUIRE(other.textureFetches == stats.textureFetches);
+                };
+                renderer.SetSimdLevel(DetectSimdLevel());
+                check(render(renderer));
+                renderer.SetThreadCount(4);
+                check(render(renderer));
+            }
+
+            THEN("deferred shading fetches each visible pixel once")
+            {
+                renderer.SetDeferredShading(true);
+                const auto deferred = render(renderer);
+                REQUIRE(deferred.depthPassed == stats.depthPassed);
+                REQUIRE(deferred.textureFetches > 0);
+                REQUIRE(deferred.textureFetches < deferred.depthPassed);
+            }
+        }
+    }
+}
+
+SCENARIO("Accessing pixels through pixel view", "[image]")
+{
+    GIVEN("RGB image")
+    {
+        TgaImage image;
+        image.CreateImage(16, 8);
+        const auto pixels = image.GetPixels();
+        WHEN("setting pixels through view and virtual interface")
+        {
+            const TgaColor color{ 200, 100, 50, 255 };
+            pixels.Set(3, 4, 0.5f, color.ToRgba());
+            image.SetPixelColor(5, 6, 0.5f, color);
+            THEN("both give the same color")
+            {
+                const auto view_color = pixels.Get(3, 4);
+                const auto virtual_color = image.GetPixelColor(5, 6)->ToRgba();
+                REQUIRE(view_color.r == virtual_color.r);
+                REQUIRE(view_color.g == virtual_color.g);
+                REQUIRE(view_color.b == virtual_color.b);
+                REQUIRE(view_color.a == virtual_color.a);
+            }
+        }
+
+        WHEN("reading outside of image")
+        {
+            const auto color = pixels.Get(16, -1);
+            THEN("color is black")
+            {
+                REQUIRE((color.r == 0 && color.g == 0 && color.b == 0 && color.a == 0));
+            }
+        }
+    }
+}
+
+SCENARIO("Parsing obj files with native parser", "[model]")
+{
+    GIVEN("triangulated obj with relative indices and missing attributes")
+    {
+        std::string text =
+            "# comment\r\n"
+            "o object\n"
+            "v 0.5 -0.25 1e-3\n"
+            "v\t-1.000001 2.5 +3.75\r\n"
+            "v 0.1 0.2 0.3\n"
+            "vt 0.25 0.75\n"
+            "vt 1 0\n"
+            "vn 0 0 1\n"
+            "f 1/1/1 2/2/1 3/1/1\n"
+            "s off\n";
+        for (int i = 0; i < 300; ++i)
+        {
+            text += "v " + std::to_string(i * 0.013f) + " " + std::to_string(-i * 0.7f) + " 0.123456789\n";
+            text += "vt 0." + std::to_string(i) + " 0.5\n";
+            text += "f -1/-1 1/1 2/2\n";
+            text += "f " + std::to_string(i + 1) + "//1 -2 -1\n";
+        }
+
+        WHEN("parsing it in one and in many chunks")
+        {
+            const auto single = ParseObj(text.data(), text.size(), 1);
+            const auto chunked = ParseObj(text.data(), text.size(), 7);
+            THEN("meshes are identical")
+            {
+                REQUIRE(single.TriangleCount() == 601);
+                REQUIRE(MeshesEqual(single.View(), chunked.View()));
+            }
+        }
+
+        WHEN("loading it with native parser and tinyobjloader")
+        {
+            const auto path = std::filesystem::temp_directory_path() / "renderer_tests_parser.obj";
+            std::ofstream(path, std::ios::binary) << text;
+
+            Obj reference;
+            reference.ReadModel(path);
+            MappedObj mapped(3);
+            mapped.ReadModel(path);
+            std::filesystem::remove(path);
+            THEN("meshes are identical")
+            {
+                REQUIRE(MeshesEqual(reference.GetMesh(), mapped.GetMesh()));
+            }
+        }
+    }
+
+    GIVEN("obj with quad faces")
+    {
+        const std::string text = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n";
+        THEN("parsing fails")
+        {
+            REQUIRE_THROWS(ParseObj(text.data(), text.size(), 1));
+        }
+    }
+
+    GIVEN("obj with face indices too long for any mesh")
+    {
+        THEN("parsing fails instead of overflowing")
+        {
+            for (const std::string index : { "4294967296", "-99999999999999999999999", "123456789012345678901234567890" })
+            {
+                const auto text = "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 " + index + "\n";
+                REQUIRE_THROWS(ParseObj(text.data(), text.size(), 1));
+            }
+        }
+    }
+}
+
+SCENARIO("Caching meshes in binary format", "[model]")
+{
+    GIVEN("mesh written to binary cache")
+    {
+        const TestModel model{ RandomPolygons(100, 5) };
+        const auto path = std::filesystem::temp_directory_path() / "renderer_tests_cache.bmesh";
+        WriteBinaryMesh(model.GetMesh(), path);
+
+        WHEN("mapping it back")
+        {
+            BinaryModel cached(true);
+            cached.ReadModel(path);
+            THEN("mesh is identical")
+            {
+                REQUIRE(cached.GetMesh().TriangleCount() == 100);
+                REQUIRE(MeshesEqual(model.GetMesh(), cached.GetMesh()));
+            }
+        }
+
+        WHEN("payload is corrupted")
+        {
+            {
+                std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+                file.seekp(-1, std::ios::end);
+                file.put('\x7f');
+            }
+            THEN("verified load fails")
+            {
+                BinaryModel cached(true);
+                REQUIRE_THROWS(cached.ReadModel(path));
+            }
+        }
+
+        WHEN("an index points past its attributes")
+        {
+            {
+                std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+                BinaryMeshHeader header;
+                file.read(reinterpret_cast<char*>(&header), sizeof(header));
+                const uint32_t index = 100 * 3;
+                file.seekp(static_cast<std::streamoff>(header.offsets[BinaryMeshHeader::PositionIndices]));
+                file.write(reinterpret_cast<const char*>(&index), sizeof(index));
+            }
+            THEN("load fails even without verifying the payload")
+            {
+                BinaryModel cached;
+                REQUIRE_THROWS(cached.ReadModel(path));
+            }
+        }
+
+        WHEN("header is corrupted")
+        {
+            {
+                std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+                file.seekp(16);
+                file.put('\x01');
+            }
+            THEN("load fails")
+            {
+                BinaryModel cached;
+                REQUIRE_THROWS(cached.ReadModel(path));
+            }
+        }
+        std::filesystem::remove(path);
+    }
+}
+
+SCENARIO("Simplifying meshes into levels of detail", "[model]")
+{
+    const auto indices_in_range = [](const MeshView& mesh) {
+        const auto in_range = [](const ArrayView<uint32_t>& indices, const size_t count) {
+            return std::all_of(indices.begin(), indices.end(), [count](const uint32_t i) { return i < count; });
+        };
+        return in_range(mesh.positionIndices, mesh.positions.size())
+            && in_range(mesh.textureIndices, mesh.textureCoords.size())
+            && in_range(mesh.normalIndices, mesh.normals.size());
+    };
+
+    GIVEN("flat grid")
+    {
+        const TestModel model{ WavyGrid(64, 0.f) };
+        const auto levels = BuildMeshLevels(model.GetMesh());
+        THEN("each level has a fraction of the triangles of the one before and no error")
+        {
+            REQUIRE(levels.size() >= 2);
+            auto previous = model.GetMesh().TriangleCount();
+            for (const auto& level : levels)
+            {
+                const auto view = level.View(model.GetMesh()).mesh;
+                REQUIRE(view.TriangleCount() * 3 < previous);
+                REQUIRE(view.TriangleCount() >= 256);
+                REQUIRE(level.error < 1e-4f);
+                REQUIRE(indices_in_range(view));
+                previous = view.TriangleCount();
+            }
+        }
+
+        THEN("coarsest level renders the same picture")
+        {
+            auto texture = CheckerTexture(64, 64);
+            TgaImage full;
+            TgaImage simplified;
+            full.CreateImage(128, 128);
+            simplified.CreateImage(128, 128);
+            LodModel lod(std::make_unique<TestModel>(WavyGrid(64, 0.f)));
+            lod.ReadModel({});
+            Renderer renderer;
+            renderer.SetLightVector({ 0, 0, -1 });
+            renderer.RenderModel(model, texture, full);
+            renderer.SetLevelOfDetail(.5f);
+            renderer.SetStatsEnabled(true);
+            renderer.RenderModel(lod, texture, simplified);
+            REQUIRE(renderer.GetStats().trianglesSubmitted == lod.GetLevels()[lod.GetLevels().size() - 1].mesh.TriangleCount());
+
+            size_t different = 0;
+            for (int32_t y = 0; y < 128; ++y)
+            {
+                for (int32_t x = 0; x < 128; ++x)
+                {
+                    const auto l = full.GetPixelColor(x, y)->ToRgba();
+                    const auto r = simplified.GetPixelColor(x, y)->ToRgba();
+                    different += l.r != r.r || l.g != r.g || l.b != r.b;
+                }
+            }
+            REQUIRE(different < 128 * 128 / 100);
+        }
+    }
+
+    GIVEN("wavy grid with levels")
+    {
+        LodModel model(std::make_unique<TestModel>(WavyGrid(128, .1f)));
+        model.ReadModel({});
+        const auto levels = model.GetLevels();
+        REQUIRE(levels.size() >= 2);
+
+        THEN("error grows level by level")
+        {
+            for (size_t i = 1; i < levels.size(); ++i)
+            {
+                REQUIRE(levels[i].error >= levels[i - 1].error);
+                REQUIRE(levels[i].error > 0.f);
+            }
+        }
+
+        THEN("smaller pictures select coarser levels")
+        {
+            const auto triangles = [&model](const Width size, const float_t max_error) {
+                return SelectLevel(model, ImageSize{ size, size }, max_error).TriangleCount();
+            };
+            REQUIRE(triangles(16, 0.f) == model.GetMesh().TriangleCount());
+            REQUIRE(triangles(4096, .5f) >= triangles(256, .5f));
+            REQUIRE(triangles(256, .5f) >= triangles(16, .5f));
+            REQUIRE(triangles(16, .5f) < model.GetMesh().TriangleCount());
+            REQUIRE(triangles(16, 1e6f) == levels[levels.size() - 1].mesh.TriangleCount());
+        }
+
+        WHEN("baked into a mesh cache")
+        {
+            const auto path = std::filesystem::temp_directory_path() / "renderer_tests_levels.bmesh";
+            WriteBinaryMesh(model.GetMesh(), path, model.GetLevels());
+            BinaryModel cached(true);
+            cached.ReadModel(path);
+            THEN("levels are read back as they were")
+            {
+                REQUIRE(cached.GetLevels().size() == levels.size());
+                for (size_t i = 0; i < levels.size(); ++i)
+                {
+                    REQUIRE(MeshesEqual(cached.GetLevels()[i].mesh, levels[i].mesh));
+                    REQUIRE(cached.GetLevels()[i].error == levels[i].error);
+                }
+            }
+
+            AND_WHEN("an index of a level points past its positions")
+            {
+                {
+                    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+                    BinaryMeshHeader header;
+                    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+                    const auto index = static_cast<uint32_t>(levels[0].mesh.positions.size());
+                    file.seekp(static_cast<std::streamoff>(header.offsets[BinaryMeshHeader::LevelIndices]));
+                    file.write(reinterpret_cast<const char*>(&index), sizeof(index));
+                }
+                THEN("load fails even without verifying the payload")
+                {
+                    BinaryModel damaged;
+                    REQUIRE_THROWS(damaged.ReadModel(path));
+                }
+            }
+            std::filesystem::remove(path);
+        }
+    }
+
+    GIVEN("triangles sharing no corners")
+    {
+        const TestModel model{ RandomPolygons(2000, 3) };
+        const auto levels = BuildMeshLevels(model.GetMesh());
+        THEN("levels keep valid indices and aren't picked for fine detail")
+        {
+            for (const auto& level : levels)
+            {
+                REQUIRE(indices_in_range(level.View(model.GetMesh()).mesh));
+                REQUIRE(level.error * 512.f > .5f);
+            }
+        }
+    }
+}
+
+SCENARIO("Reordering meshes for locality", "[model]")
+{
+    GIVEN("grid with its triangles scattered")
+    {
+        const TestModel shuffled{ ShuffleTriangles(WavyGrid(64, .1f), 7) };
+        const auto polygons = [](const MeshView& mesh) {
+            std::vector<std::array<float_t, 15>> corners;
+            for (size_t i = 0; i < mesh.TriangleCount(); ++i)
+            {
+                const auto polygon = mesh.GetPolygon(i);
+                std::array<float_t, 15> values;
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    for (size_t c = 0; c < 3; ++c)
+                        values[k * 5 + c] = polygon.vertices[k][c];
+                    values[k * 5 + 3] = get_x(polygon.textureCoordinates[k]);
+                    values[k * 5 + 4] = get_y(polygon.textureCoordinates[k]);
+                }
+                corners.push_back(values);
+            }
+            std::sort(corners.begin(), corners.end());
+            return corners;
+        };
+
+        WHEN("reordered")
+        {
+            const TestModel reordered{ ReorderMesh(shuffled.GetMesh()) };
+            THEN("the same triangles reuse far more vertices")
+            {
+                REQUIRE(polygons(reordered.GetMesh()) == polygons(shuffled.GetMesh()));
+                REQUIRE(reordered.GetMesh().positions.size() == 65 * 65);
+                REQUIRE(VertexCacheMissRatio(shuffled.GetMesh()) > 2.f);
+                REQUIRE(VertexCacheMissRatio(reordered.GetMesh()) < 1.f);
+            }
+
+            THEN("picture is unchanged")
+            {
+                auto texture = CheckerTexture(64, 64);
+                TgaImage before;
+                TgaImage after;
+                before.CreateImage(128, 128);
+                after.CreateImage(128, 128);
+                Renderer renderer;
+                renderer.SetLightVector({ 0, 0, -1 });
+                renderer.RenderModel(shuffled, texture, before);
+                renderer.RenderModel(reordered, texture, after);
+                REQUIRE(ImagesEqual(before, after));
+            }
+        }
+
+        WHEN("read through a reordering model")
+        {
+            ReorderedModel model(std::make_unique<TestModel>(ShuffleTriangles(WavyGrid(64, .1f), 7)));
+            model.ReadModel({});
+            THEN("it holds the reordered mesh and can't be read again")
+            {
+                REQUIRE(MeshesEqual(model.GetMesh(), ReorderMesh(shuffled.GetMesh()).View()));
+                REQUIRE_THROWS(model.ReadModel({}));
+            }
+        }
+
+        WHEN("only sorted spatially")
+        {
+            MeshOrderOptions options;
+            options.vertexCache = false;
+            const TestModel sorted{ ReorderMesh(shuffled.GetMesh(), options) };
+            THEN("consecutive triangles lie close together")
+            {
+                const auto mean_step = [](const MeshView& mesh) {
+                    float_t total = 0.f;
+                    for (size_t i = 1; i < mesh.TriangleCount(); ++i)
+                    {
+                        const auto step = mesh.GetPolygon(i).vertices[0] - mesh.GetPolygon(i - 1).vertices[0];
+                        total += std::sqrt(dot(step, step));
+                    }
+                    return total / (mesh.TriangleCount() - 1);
+                };
+                REQUIRE(polygons(sorted.GetMesh()) == polygons(shuffled.GetMesh()));
+                REQUIRE(mean_step(sorted.GetMesh()) * 10.f < mean_step(shuffled.GetMesh()));
+            }
+        }
+    }
+}
+
+SCENARIO("Sampling mipmapped texture", "[texture]")
+{
+    auto image = CheckerTexture(64, 32);
+    GIVEN("texture with mip chain")
+    {
+        const Texture texture(std::as_const(image).GetPixels(), true);
+        THEN("levels go down to a single texel")
+        {
+            REQUIRE(texture.LevelCount() == 7);
+            REQUIRE(texture.GetLevelSize(1) == ImageSize{ 32, 16 });
+            REQUIRE(texture.GetLevelSize(6) == ImageSize{ 1, 1 });
+        }
+
+        THEN("level 0 keeps every texel of the image")
+        {
+            const auto pixels = std::as_const(image).GetPixels();
+            bool same = true;
+            for (int32_t y = 0; y < 32; ++y)
+            {
+                for (int32_t x = 0; x < 64; ++x)
+                {
+                    const auto a = texture.GetTexel(0, x, y);
+                    const auto b = pixels.Get(x, y);
+                    same = same && a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+                }
+            }
+            REQUIRE(same);
+        }
+
+        WHEN("triangle covers as many pixels as texels")
+        {
+            const Triangle screen = {{{0.f, 0.f, 0.f}, {64.f, 0.f, 0.f}, {0.f, 32.f, 0.f}}};
+            const TexCoords uv = {{{0.f, 0.f}, {1.f, 0.f}, {0.f, 1.f}}};
+            THEN("base level is selected")
+            {
+                REQUIRE(texture.SelectLevel(screen, uv) == 0);
+            }
+        }
+
+        WHEN("triangle is minified four times")
+        {
+            const Triangle screen = {{{0.f, 0.f, 0.f}, {16.f, 0.f, 0.f}, {0.f, 8.f, 0.f}}};
+            const TexCoords uv = {{{0.f, 0.f}, {1.f, 0.f}, {0.f, 1.f}}};
+            THEN("level 2 is selected")
+            {
+                REQUIRE(texture.SelectLevel(screen, uv) == 2);
+            }
+        }
+    }
+
+    GIVEN("model rendered with image and with texture without mipmaps")
+    {
+        const TestModel model{ RandomPolygons(300, 99) };
+        Renderer renderer;
+        renderer.SetLightVector({ 0, 0, -1 });
+
+        TgaImage from_image;
+        from_image.CreateImage(160, 120);
+        renderer.RenderModel(model, image, from_image);
+
+        TgaImage from_texture;
+        from_texture.CreateImage(160, 120);
+        renderer.RenderModel(model, Texture(std::as_const(image).GetPixels()), from_texture);
+        THEN("images are identical")
+        {
+            REQUIRE(ImagesEqual(from_image, from_texture));
+        }
+    }
+}
+
+SCENARIO("Rendering jobs from batch manifest", "[batch]")
+{
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto manifest_path = directory / "renderer_tests_manifest.txt";
+    GIVEN("manifest with several jobs sharing one model and texture")
+    {
+        {
+            std::ofstream manifest(manifest_path);
+            manifest << "# model texture width height lx ly lz output\n\n";
+            for (int i = 0; i < 4; ++i)
+            {
+                manifest << "model.obj texture.tga 97 61 0 0 -1 "
+                    << (directory / ("renderer_tests_job" + std::to_string(i) + ".tga")).string() << "\n";
+            }
+        }
+
+        std::atomic<int> models_loaded{ 0 };
+        std::atomic<int> textures_loaded{ 0 };
+        const auto polygons = RandomPolygons(200, 11);
+        auto texture_image = CheckerTexture(64, 64);
+        AssetCache cache(
+            [&](const std::string&) { ++models_loaded; return std::make_unique<TestModel>(polygons); },
+            [&](const std::string&) { ++textures_loaded; return std::make_unique<Texture>(std::as_const(texture_image).GetPixels()); });
+
+        WHEN("running it on several workers")
+        {
+            const auto jobs = ReadManifest(manifest_path);
+            BatchOptions options;
+            options.concurrentJobs = 3;
+            std::ostringstream log;
+            const auto failed = RunBatch(jobs, cache, options, log);
+
+            THEN("every job is rendered from assets loaded once")
+            {
+                REQUIRE(jobs.size() == 4);
+                REQUIRE(failed == 0);
+                REQUIRE(models_loaded == 1);
+                REQUIRE(textures_loaded == 1);
+
+                TgaImage expected;
+                expected.CreateImage(97, 61);
+                Renderer renderer;
+                renderer.SetLightVector({ 0, 0, -1 });
+                renderer.RenderModel(TestModel{ polygons }, Texture(std::as_const(texture_image).GetPixels()), expected);
+                expected.WriteImage(directory / "renderer_tests_expected.tga");
+                expected.ReadImage(directory / "renderer_tests_expected.tga");
+                for (const auto& job : jobs)
+                {
+                    TgaImage rendered;
+                    rendered.ReadImage(job.outputFilename);
+                    REQUIRE(ImagesEqual(expected, rendered));
+                }
+            }
+        }
+    }
+
+    GIVEN("a model that is slow to load and a job waiting for it")
+    {
+        std::promise<void> release;
+        const auto released = release.get_future().share();
+        const auto polygons = RandomPolygons(10, 3);
+        auto texture_image = CheckerTexture(8, 8);
+        AssetCache cache(
+            [&](const std::string& path) {
+                if (path == "slow.obj")
+                    released.wait();
+                return std::make_unique<TestModel>(polygons);
+            },
+            [&](const std::string&) { return std::make_unique<Texture>(std::as_const(texture_image).GetPixels()); });
+
+        auto loading = std::async(std::launch::async, [&cache] { return cache.GetModel("slow.obj"); });
+        auto waiting = std::async(std::launch::async, [&cache] { return cache.GetModel("slow.obj"); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        WHEN("other assets are asked for meanwhile")
+        {
+            auto other = std::async(std::launch::async, [&cache] {
+                return cache.GetModel("other.obj") && cache.GetTexture("texture.tga");
+            });
+            const auto loaded = other.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+            release.set_value();
+
+            THEN("they load without waiting for the slow one")
+            {
+                REQUIRE(loaded);
+                REQUIRE(other.get());
+                REQUIRE(loading.get() == waiting.get());
+            }
+        }
+    }
+
+    GIVEN("manifest with paths containing spaces in quotes")
+    {
+        {
+            std::ofstream manifest(manifest_path);
+            manifest << "  # comment\n\"my model.obj\"\ttexture.tga 97 61 0 0 -1 \"out dir/job 1.tga\"\n";
+        }
+        THEN("the quotes are dropped and the spaces kept")
+        {
+            const auto jobs = ReadManifest(manifest_path);
+            REQUIRE(jobs.size() == 1);
+            REQUIRE(jobs[0].modelFilename == "my model.obj");
+            REQUIRE(jobs[0].textureFilename == "texture.tga");
+            REQUIRE(jobs[0].width == 97);
+            REQUIRE(jobs[0].height == 61);
+            REQUIRE(jobs[0].outputFilename == "out dir/job 1.tga");
+        }
+    }
+
+    GIVEN("manifests with malformed jobs")
+    {
+        const std::vector<std::string> lines{
+            "model.obj texture.tga 97 61 0 0 -1",
+            "model.obj texture.tga 97 61 0 0 -1 out.tga extra",
+            "model.obj texture.tga 97 61 0 0 -1 out dir/job.tga",
+            "model.obj texture.tga 97 61.5 0 0 -1 out.tga",
+            "model.obj texture.tga 97 0 0 0 -1 out.tga",
+            "\"my model.obj texture.tga 97 61 0 0 -1 out.tga",
+            "\"my model\".obj texture.tga 97 61 0 0 -1 out.tga" };
+        THEN("reading any of them fails")
+        {
+            for (const auto& line : lines)
+            {
+                {
+                    std::ofstream manifest(manifest_path);
+                    manifest << line << "\n";
+                }
+                REQUIRE_THROWS(ReadManifest(manifest_path));
+            }
+        }
+    }
+}
+
+SCENARIO("Rendering frame sequence", "[sequence]")
+{
+    const auto directory = std::filesystem::temp_directory_path();
+    auto texture_image = CheckerTexture(64, 64);
+    const Texture texture(std::as_const(texture_image).GetPixels());
+    GIVEN("model turned around over several frames")
+    {
+        const TestModel model{ RandomPolygons(200, 21) };
+        SequenceOptions options;
+        options.frameCount = 6;
+        options.sweep = SequenceSweep::Rotation;
+        options.width = 83;
+        options.height = 71;
+        options.queueDepth = 1;
+
+        WHEN("rendering the sequence")
+        {
+            Renderer renderer;
+            RenderSequence(model, texture, renderer, options, [&directory](const ConstPixelView& pixels, const uint32_t frame) {
+                WriteTga(pixels, FrameFilename(directory / "renderer_tests_seq.tga", frame));
+            });
+
+            THEN("every frame is written and the first one matches a single render")
+            {
+                REQUIRE(FrameFilename("out/seq.tga", 12) == std::filesystem::path("out/seq_0012.tga"));
+
+                TgaImage expected;
+                expected.CreateImage(83, 71);
+                renderer.SetLightVector({ 0, 0, -1 });
+                renderer.RenderModel(model, texture, expected);
+                expected.WriteImage(directory / "renderer_tests_expected.tga");
+                expected.ReadImage(directory / "renderer_tests_expected.tga");
+
+                TgaImage first;
+                first.ReadImage(FrameFilename(directory / "renderer_tests_seq.tga", 0));
+                REQUIRE(ImagesEqual(expected, first));
+
+                TgaImage last;
+                last.ReadImage(FrameFilename(directory / "renderer_tests_seq.tga", 5));
+                REQUIRE_FALSE(ImagesEqual(expected, last));
+            }
+        }
+    }
+}
+
+SCENARIO("Encoding TGA files in parallel bands", "[image]")
+{
+    const auto directory = std::filesystem::temp_directory_path();
+    for (const auto bytes_per_pixel : { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA })
+    {
+        GIVEN("image with runs crossing row boundaries, " + std::to_string(bytes_per_pixel) + " bytes per pixel")
+        {
+            TGAImage image(53, 41, bytes_per_pixel);
+            std::mt19937 gen(bytes_per_pixel);
+            std::uniform_int_distribution<int> palette(0, 3);
+            std::bernoulli_distribution change(0.3);
+            TGAColor color;
+            for (int y = 0; y < image.get_height(); ++y)
+            {
+                for (int x = 0; x < image.get_width(); ++x)
+                {
+                    if (change(gen))
+                        color = TGAColor(static_cast<unsigned char>(palette(gen) * 60), 7, 9, 255);
+                    image.set(x, y, color);
+                }
+            }
+
+            TGAImage flipped(image);
+            flipped.flip_vertically();
+            flipped.write_tga_file((directory / "renderer_tests_rle_reference.tga").string().c_str());
+            flipped.write_tga_file((directory / "renderer_tests_raw_reference.tga").string().c_str(), false);
+            const ConstPixelView pixels{ image.buffer(), 53, 41, static_cast<size_t>(bytes_per_pixel) };
+
+            WHEN("writing it directly with different band counts")
+            {
+                THEN("files are byte-identical to flipping and writing")
+                {
+                    for (const size_t bands : { 1, 2, 3, 7, 41 })
+                    {
+                        WriteTga(pixels, directory / "renderer_tests_encoded.tga", true, bands);
+                        REQUIRE(ReadFile(directory / "renderer_tests_encoded.tga")
+                            == ReadFile(directory / "renderer_tests_rle_reference.tga"));
+                    }
+                    WriteTga(pixels, directory / "renderer_tests_encoded.tga", false);
+                    REQUIRE(ReadFile(directory / "renderer_tests_encoded.tga")
+                        == ReadFile(directory / "renderer_tests_raw_reference.tga"));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Decoding TGA files from mapped memory", "[image]")
+{
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto path = directory / "renderer_tests_decode.tga";
+    const auto write_file = [&path](const std::string& bytes) {
+        std::ofstream file(path, std::ios::binary);
+        file << bytes;
+    };
+
+    for (const auto bytes_per_pixel : { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA })
+    {
+        GIVEN("files written by TGAImage, " + std::to_string(bytes_per_pixel) + " bytes per pixel")
+        {
+            TGAImage image(37, 29, bytes_per_pixel);
+            std::mt19937 gen(bytes_per_pixel + 10);
+            std::uniform_int_distribution<int> palette(0, 3);
+            for (int y = 0; y < image.get_height(); ++y)
+            {
+                for (int x = 0; x < image.get_width(); ++x)
+                {
+                    image.set(x, y, TGAColor(static_cast<unsigned char>(palette(gen) * 60), 3, 5, 128));
+                }
+            }
+
+            for (const auto rle : { true, false })
+            {
+                for (const auto top_down : { true, false })
+                {
+                    image.write_tga_file(path.string().c_str(), rle);
+                    if (!top_down)
+                    {
+                        auto bytes = ReadFile(path);
+                        bytes[17] = 0;
+                        write_file(bytes);
+                    }
+
+                    TGAImage expected;
+                    REQUIRE(expected.read_tga_file(path.string().c_str()));
+
+                    const TgaDecoder decoder(path);
+                    REQUIRE(decoder.Info().bytesPerPixel == static_cast<size_t>(bytes_per_pixel));
+                    std::vector<uint8_t> decoded(37 * 29 * bytes_per_pixel);
+                    decoder.Decode(PixelView{ decoded.data(), 37, 29, static_cast<size_t>(bytes_per_pixel) });
+                    REQUIRE(std::equal(decoded.begin(), decoded.end(), expected.buffer()));
+
+                    std::vector<uint8_t> expanded(37 * 29 * 4);
+                    const PixelView expanded_view{ expanded.data(), 37, 29, 4 };
+                    decoder.Decode(expanded_view);
+                    const auto reference = expected.get(5, 7);
+                    const auto pixel = expanded_view.Pixel(5, 7);
+                    for (int i = 0; i < bytes_per_pixel; ++i)
+                    {
+                        REQUIRE(pixel[i] == reference.bgra[i]);
+                    }
+                    REQUIRE(pixel[3] == (bytes_per_pixel == TGAImage::RGBA ? 128 : 255));
+                }
+            }
+        }
+    }
+
+    GIVEN("corrupted files")
+    {
+        TGAImage image(16, 16, TGAImage::RGB);
+        image.write_tga_file(path.string().c_str());
+        const auto valid = ReadFile(path);
+
+        THEN("bad headers and truncated data are rejected")
+        {
+            auto bad_type = valid;
+            bad_type[2] = 7;
+            write_file(bad_type);
+            REQUIRE_THROWS(TgaDecoder(path));
+
+            auto bad_depth = valid;
+            bad_depth[16] = 16;
+            write_file(bad_depth);
+            REQUIRE_THROWS(TgaDecoder(path));
+
+            write_file(valid.substr(0, 10));
+            REQUIRE_THROWS(TgaDecoder(path));
+
+            write_file(valid.substr(0, 20));
+            const TgaDecoder truncated(path);
+            std::vector<uint8_t> pixels(16 * 16 * 3);
+            REQUIRE_THROWS(truncated.Decode(PixelView{ pixels.data(), 16, 16, 3 }));
+        }
+    }
+}
+
+SCENARIO("Streaming raw frames", "[image]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "renderer_tests_stream.ppm";
+    GIVEN("framebuffer with distinct bottom and top rows")
+    {
+        TgaImage image;
+        image.CreateImage(2, 2);
+        image.SetPixelColor(0, 0, 1.f, TgaColor{ 10, 20, 30 });
+        image.SetPixelColor(1, 1, 1.f, TgaColor{ 40, 50, 60 });
+        const auto pixels = std::as_const(image).GetPixels();
+        const auto top_left = pixels.Get(0, 1);
+        const auto top_right = pixels.Get(1, 1);
+
+        WHEN("streaming two PPM frames and one RGBA frame")
+        {
+            {
+                FrameStream stream(path, OutputFormat::Ppm);
+                stream.Write(pixels);
+                stream.Write(pixels);
+            }
+            const auto ppm = ReadFile(path);
+            {
+                FrameStream stream(path, OutputFormat::Rgba);
+                stream.Write(pixels);
+            }
+            const auto rgba = ReadFile(path);
+
+            THEN("frames are concatenated, top row first, in RGB byte order")
+            {
+                const std::string header = "P6\n2 2\n255\n";
+                REQUIRE(ppm.size() == 2 * (header.size() + 12));
+                REQUIRE(ppm.compare(0, header.size(), header) == 0);
+                REQUIRE(static_cast<uint8_t>(ppm[header.size()]) == top_left.r);
+                REQUIRE(static_cast<uint8_t>(ppm[header.size() + 3]) == top_right.r);
+                REQUIRE(static_cast<uint8_t>(ppm[header.size() + 4]) == top_right.g);
+                REQUIRE(static_cast<uint8_t>(ppm[header.size() + 5]) == top_right.b);
+
+                REQUIRE(rgba.size() == 16);
+                REQUIRE(static_cast<uint8_t>(rgba[4]) == top_right.r);
+                REQUIRE(static_cast<uint8_t>(rgba[7]) == 255);
+            }
+        }
+    }
+}
@@ -0,0 +1,156 @@
+#include "texture.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr int32_t tile_shift = 3;
+    constexpr int32_t tile_texels = 1 << tile_shift;
+    constexpr int32_t tile_mask = tile_texels - 1;
+}
+
+Texture::Texture(const ConstPixelView& image, const bool mipmaps, const TextureFilter filter) :
+    m_filter(filter)
+{
+    auto width = std::max(static_cast<int32_t>(image.width), 1);
+    auto height = std::max(static_cast<int32_t>(image.height), 1);
+    size_t offset = 0;
+    while (true)
+    {
+        const auto tiles_x = (width + tile_mask) >> tile_shift;
+        const auto tiles_y = (height + tile_mask) >> tile_shift;
+        m_levels.push_back({ width, height, tiles_x, offset });
+        offset += static_cast<size_t>(tiles_x) * tiles_y * tile_texels * tile_texels;
+
+        if (!mipmaps || (width == 1 && height == 1))
+            break;
+
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    m_texels.resize(offset);
+
+    const auto& base = m_levels.front();
+    for (int32_t y = 0; y < base.height; ++y)
+    {
+        for (int32_t x = 0; x < base.width; ++x)
+        {
+            m_texels[TexelIndex(base, x, y)] = image.Get(x, y);
+        }
+    }
+
+    // Each level is a 2x2 box filter of the previous one, clamped at the
+    // edges for odd sizes.
+    for (size_t i = 1; i < m_levels.size(); ++i)
+    {
+        const auto& source = m_levels[i - 1];
+        const auto& level = m_levels[i];
+        for (int32_t y = 0; y < level.height; ++y)
+        {
+            for (int32_t x = 0; x < level.width; ++x)
+            {
+                const auto x0 = std::min(2 * x, source.width - 1);
+                const auto x1 = std::min(2 * x + 1, source.width - 1);
+                const auto y0 = std::min(2 * y, source.height - 1);
+                const auto y1 = std::min(2 * y + 1, source.height - 1);
+                const RGBA texels[4] = {
+                    m_texels[TexelIndex(source, x0, y0)], m_texels[TexelIndex(source, x1, y0)],
+                    m_texels[TexelIndex(source, x0, y1)], m_texels[TexelIndex(source, x1, y1)] };
+
+                const auto average = [&texels](uint8_t RGBA::* channel) {
+                    return static_cast<uint8_t>((texels[0].*channel + texels[1].*channel +
+                        texels[2].*channel + texels[3].*channel + 2) / 4);
+                };
+                m_texels[TexelIndex(level, x, y)] = {
+                    average(&RGBA::r), average(&RGBA::g), average(&RGBA::b), average(&RGBA::a) };
+            }
+        }
+    }
+}
+
+size_t Texture::TexelIndex(const Level& level, const int32_t x, const int32_t y) const
+{
+    const auto tile = static_cast<size_t>(y >> tile_shift) * level.tilesX + (x >> tile_shift);
+    return level.offset + (tile << (2 * tile_shift)) + ((y & tile_mask) << tile_shift) + (x & tile_mask);
+}
+
+ImageSize Texture::GetLevelSize(const size_t level) const
+{
+    return { static_cast<Width>(m_levels[level].width), static_cast<Height>(m_levels[level].height) };
+}
+
+RGBA Texture::GetTexel(const size_t level, const int32_t x, const int32_t y) const
+{
+    const auto& l = m_levels[level];
+    if (x < 0 || y < 0 || x >= l.width || y >= l.height)
+        return { 0, 0, 0, 0 };
+
+    return m_texels[TexelIndex(l, x, y)];
+}
+
+size_t Texture::SelectLevel(const Triangle& screen_triangle, const TextureCoords& texture_coords) const
+{
+    if (m_levels.size() == 1)
+        return 0;
+
+    const auto area = [](const auto& a, const auto& b, const auto& c) {
+        return std::abs((get_x(b) - get_x(a)) * (get_y(c) - get_y(a)) -
+            (get_y(b) - get_y(a)) * (get_x(c) - get_x(a)));
+    };
+
+    const auto& base = m_levels.front();
+    const auto screen_area = area(screen_triangle[0], screen_triangle[1], screen_triangle[2]);
+    const auto texel_area = area(texture_coords[0], texture_coords[1], texture_coords[2])
+        * static_cast<float_t>(base.width) * static_cast<float_t>(base.height);
+    if (screen_area <= 0.f || texel_area <= 0.f)
+        return 0;
+
+    // Texels per pixel along one axis is the square root of the area ratio.
+    const auto lod = 0.5f * std::log2(texel_area / screen_area);
+    const auto level = static_cast<int32_t>(std::floor(lod + 0.5f));
+    return static_cast<size_t>(std::clamp(level, 0, static_cast<int32_t>(m_levels.size()) - 1));
+}
+
+RGBA Texture::Sample(const vec3f& barycentric, const TextureCoords& texture_coords, const size_t level) const
+{
+    const auto& l = m_levels[level];
+    const auto p_uv =
+        texture_coords[0] * barycentric[0] +
+        texture_coords[1] * barycentric[1] +
+        texture_coords[2] * barycentric[2];
+
+    const auto width = static_cast<Width>(l.width);
+    const auto height = static_cast<Height>(l.height);
+    if (m_filter == TextureFilter::Nearest)
+    {
+        return GetTexel(level,
+            static_cast<int>(width - get_x(p_uv)*width),
+            static_cast<int>(height - get_y(p_uv)*height));
+    }
+
+    const auto fx = (width - get_x(p_uv)*width) - 0.5f;
+    const auto fy = (height - get_y(p_uv)*height) - 0.5f;
+    const auto x0 = static_cast<int32_t>(std::floor(fx));
+    const auto y0 = static_cast<int32_t>(std::floor(fy));
+    const auto tx = fx - x0;
+    const auto ty = fy - y0;
+
+    const auto clamped = [&](const int32_t x, const int32_t y) {
+        return m_texels[TexelIndex(l, std::clamp(x, 0, l.width - 1), std::clamp(y, 0, l.height - 1))];
+    };
+    const auto t00 = clamped(x0, y0);
+    const auto t10 = clamped(x0 + 1, y0);
+    const auto t01 = clamped(x0, y0 + 1);
+    const auto t11 = clamped(x0 + 1, y0 + 1);
+
+    const auto blend = [tx, ty](const uint8_t c00, const uint8_t c10, const uint8_t c01, const uint8_t c11) {
+        const auto top = c00 + (c10 - c00) * tx;
+        const auto bottom = c01 + (c11 - c01) * tx;
+        return static_cast<uint8_t>(top + (bottom - top) * ty + 0.5f);
+    };
+    return {
+        blend(t00.r, t10.r, t01.r, t11.r),
+        blend(t00.g, t10.g, t01.g, t11.g),
+        blend(t00.b, t10.b, t01.b, t11.b),
+        blend(t00.a, t10.a, t01.a, t11.a) };
+}
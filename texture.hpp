@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include "img.hpp"
+#include "model.hpp"
+#include "rasterizer.hpp"
+
+enum class TextureFilter
+{
+    Nearest,
+    Bilinear
+};
+
+// Sampling-ready copy of an image built once at load time. Every mip level
+// is stored as RGBA in 8x8 texel tiles, so neighbouring texels in both
+// directions share cache lines. Level 0 with nearest filtering samples
+// exactly the texels Renderer::GetColorFromTexture picks from the image.
+class Texture
+{
+    struct Level
+    {
+        int32_t width;
+        int32_t height;
+        int32_t tilesX;
+        size_t offset;
+    };
+
+    std::vector<RGBA> m_texels;
+    std::vector<Level> m_levels;
+    TextureFilter m_filter;
+
+    size_t TexelIndex(const Level& level, const int32_t x, const int32_t y) const;
+
+public:
+    Texture(const ConstPixelView& image, const bool mipmaps = false, const TextureFilter filter = TextureFilter::Nearest);
+
+    size_t LevelCount() const { return m_levels.size(); }
+    ImageSize GetLevelSize(const size_t level) const;
+    RGBA GetTexel(const size_t level, const int32_t x, const int32_t y) const;
+
+    size_t SelectLevel(const Triangle& screen_triangle, const TextureCoords& texture_coords) const;
+    RGBA Sample(const vec3f& barycentric, const TextureCoords& texture_coords, const size_t level) const;
+};
@@ -0,0 +1,452 @@
+#include "tgacodec.hpp"
+#include "img/tgaimage.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr size_t max_packet_length = 128;
+    constexpr size_t min_band_pixels = 1 << 16;
+    // Packet starts kept per band to line it up with the packet stream of
+    // the bands before it; greedy RLE resynchronizes within a few packets.
+    constexpr size_t sync_window = 256;
+
+    struct EncodedBand
+    {
+        size_t first;
+        size_t last;
+        size_t next;
+        std::vector<uint8_t> bytes;
+        std::vector<size_t> starts;
+        std::vector<size_t> offsets;
+    };
+
+    // Walks the image in file order, from its last row to its first, and
+    // makes the same packet decisions as TGAImage::unload_rle_data.
+    template <size_t BytesPerPixel>
+    class RleEncoder
+    {
+        const uint8_t* m_data;
+        size_t m_width;
+        size_t m_height;
+        size_t m_pixelCount;
+
+        const uint8_t* Pixel(const size_t p) const
+        {
+            const auto row = p / m_width;
+            return m_data + ((m_height - 1 - row) * m_width + p - row * m_width) * BytesPerPixel;
+        }
+
+        // Only called while a next pixel exists.
+        const uint8_t* Next(const uint8_t* pixel, size_t& x) const
+        {
+            if (++x < m_width)
+                return pixel + BytesPerPixel;
+
+            x = 0;
+            return pixel + BytesPerPixel - 2 * m_width * BytesPerPixel;
+        }
+
+    public:
+        explicit RleEncoder(const ConstPixelView& pixels)
+            : m_data(pixels.data)
+            , m_width(pixels.width)
+            , m_height(pixels.height)
+            , m_pixelCount(pixels.width * pixels.height)
+        {}
+
+        size_t PixelCount() const { return m_pixelCount; }
+
+        // Appends the packet starting at pixel start and returns the pixel
+        // following it.
+        size_t EncodePacket(const size_t start, std::vector<uint8_t>& out) const
+        {
+            const auto first = Pixel(start);
+            const auto first_x = start % m_width;
+
+            auto current = first;
+            auto x = first_x;
+            size_t run_length = 1;
+            bool raw = true;
+            while (start + run_length < m_pixelCount && run_length < max_packet_length)
+            {
+                const auto next = Next(current, x);
+                const auto same = std::memcmp(current, next, BytesPerPixel) == 0;
+                current = next;
+                if (run_length == 1)
+                    raw = !same;
+                if (raw && same)
+                {
+                    --run_length;
+                    break;
+                }
+                if (!raw && !same)
+                    break;
+
+                ++run_length;
+            }
+
+            if (!raw)
+            {
+                out.push_back(static_cast<uint8_t>(run_length + 127));
+                out.insert(out.end(), first, first + BytesPerPixel);
+                return start + run_length;
+            }
+
+            out.push_back(static_cast<uint8_t>(run_length - 1));
+            auto segment = first;
+            auto column = first_x;
+            for (auto remaining = run_length; remaining > 0;)
+            {
+                const auto count = std::min(remaining, m_width - column);
+                out.insert(out.end(), segment, segment + count * BytesPerPixel);
+                remaining -= count;
+                if (remaining > 0)
+                    segment += count * BytesPerPixel - 2 * m_width * BytesPerPixel;
+                column = 0;
+            }
+            return start + run_length;
+        }
+
+        void EncodeBand(EncodedBand& band) const
+        {
+            const auto pixels = band.last - band.first;
+            band.bytes.reserve(pixels * BytesPerPixel + pixels / max_packet_length + 1);
+            auto p = band.first;
+            while (p < band.last)
+            {
+                if (band.starts.size() < sync_window)
+                {
+                    band.starts.push_back(p);
+                    band.offsets.push_back(band.bytes.size());
+                }
+                p = EncodePacket(p, band.bytes);
+            }
+            band.next = p;
+        }
+    };
+
+    [[noreturn]] void ThrowDecodeError(const std::string& reason)
+    {
+        throw std::runtime_error("Failed to read .tga file, reason:\n" + reason);
+    }
+
+    template <size_t SourceBpp, size_t TargetBpp>
+    struct PixelExpand
+    {
+        static void Expand(const uint8_t* source, uint8_t* target)
+        {
+            std::memcpy(target, source, SourceBpp);
+            for (size_t i = SourceBpp; i < TargetBpp; ++i)
+            {
+                target[i] = i == 3 ? 255 : 0;
+            }
+        }
+
+        static void Copy(const uint8_t* source, const size_t count, uint8_t* target)
+        {
+            if constexpr (SourceBpp == TargetBpp)
+            {
+                std::memcpy(target, source, count * SourceBpp);
+            }
+            else
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    Expand(source + i * SourceBpp, target + i * TargetBpp);
+                }
+            }
+        }
+
+        static void Fill(const uint8_t* source, const size_t count, uint8_t* target)
+        {
+            uint8_t pixel[TargetBpp];
+            Expand(source, pixel);
+            if constexpr (TargetBpp == 1)
+            {
+                std::memset(target, pixel[0], count);
+            }
+            else
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    std::memcpy(target + i * TargetBpp, pixel, TargetBpp);
+                }
+            }
+        }
+    };
+
+    // Packets may span rows; spans are split at row ends so every row lands
+    // where the origin flag puts it.
+    template <size_t SourceBpp, size_t TargetBpp>
+    void DecodePixels(const uint8_t* cur, const uint8_t* end, const bool rle, const bool top_down, const PixelView& out)
+    {
+        using Pixels = PixelExpand<SourceBpp, TargetBpp>;
+        const auto width = out.width;
+        const auto height = out.height;
+        const auto row_bytes = width * TargetBpp;
+        const auto row_start = [&](const size_t row) {
+            return out.data + (top_down ? row : height - 1 - row) * row_bytes;
+        };
+
+        size_t row = 0;
+        size_t x = 0;
+        auto target_row = row_start(0);
+        const auto emit = [&](size_t count, const auto& write) {
+            while (count > 0)
+            {
+                const auto span = std::min(count, width - x);
+                write(target_row + x * TargetBpp, span);
+                count -= span;
+                x += span;
+                if (x == width)
+                {
+                    x = 0;
+                    if (++row < height)
+                        target_row = row_start(row);
+                }
+            }
+        };
+        const auto copy = [&cur](uint8_t* target, const size_t span) {
+            Pixels::Copy(cur, span, target);
+            cur += span * SourceBpp;
+        };
+
+        const auto total = width * height;
+        if (!rle)
+        {
+            if (static_cast<size_t>(end - cur) / SourceBpp < total)
+                ThrowDecodeError("pixel data is truncated");
+
+            emit(total, copy);
+            return;
+        }
+
+        for (size_t decoded = 0; decoded < total;)
+        {
+            if (cur == end)
+                ThrowDecodeError("pixel data is truncated");
+
+            const auto packet = *cur++;
+            const size_t count = (packet & 0x7f) + 1;
+            if (count > total - decoded)
+                ThrowDecodeError("packet runs past the last pixel");
+
+            const auto payload = (packet & 0x80) ? SourceBpp : count * SourceBpp;
+            if (static_cast<size_t>(end - cur) < payload)
+                ThrowDecodeError("pixel data is truncated");
+
+            if (packet & 0x80)
+            {
+                const auto pixel = cur;
+                cur += SourceBpp;
+                emit(count, [pixel](uint8_t* target, const size_t span) { Pixels::Fill(pixel, span, target); });
+            }
+            else
+            {
+                emit(count, copy);
+            }
+            decoded += count;
+        }
+    }
+
+    void WriteBytes(std::ofstream& out, const uint8_t* data, const size_t size)
+    {
+        out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        if (!out.good())
+            throw std::runtime_error("Couldn't save file");
+    }
+
+    size_t AutoBandCount(const size_t pixel_count)
+    {
+        const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        return std::max<size_t>(1, std::min(threads, pixel_count / min_band_pixels));
+    }
+
+    template <size_t BytesPerPixel>
+    void WriteRle(std::ofstream& out, const ConstPixelView& pixels, const size_t band_count)
+    {
+        const RleEncoder<BytesPerPixel> encoder(pixels);
+        const auto rows = pixels.height;
+        const auto bands_nr = std::min(band_count != 0 ? band_count : AutoBandCount(encoder.PixelCount()), rows);
+
+        std::vector<EncodedBand> bands(bands_nr);
+        for (size_t i = 0; i < bands_nr; ++i)
+        {
+            bands[i].first = rows * i / bands_nr * pixels.width;
+            bands[i].last = rows * (i + 1) / bands_nr * pixels.width;
+        }
+
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < bands_nr; ++i)
+        {
+            workers.emplace_back([&encoder, &band = bands[i]]() { encoder.EncodeBand(band); });
+        }
+        encoder.EncodeBand(bands[0]);
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        // A packet may run past the end of its band, in which case the next
+        // band's packets are only valid from the first start both agree on.
+        size_t pos = 0;
+        std::vector<uint8_t> fixup;
+        for (const auto& band : bands)
+        {
+            fixup.clear();
+            auto sync = std::lower_bound(band.starts.begin(), band.starts.end(), pos);
+            while (pos < band.last && (sync == band.starts.end() || *sync != pos))
+            {
+                pos = encoder.EncodePacket(pos, fixup);
+                sync = std::lower_bound(sync, band.starts.end(), pos);
+            }
+            WriteBytes(out, fixup.data(), fixup.size());
+
+            if (pos < band.last)
+            {
+                const auto offset = band.offsets[sync - band.starts.begin()];
+                WriteBytes(out, band.bytes.data() + offset, band.bytes.size() - offset);
+                pos = band.next;
+            }
+        }
+    }
+}
+
+TgaDecoder::TgaDecoder(const std::filesystem::path& path_to_read)
+    : m_file(path_to_read)
+{
+    constexpr size_t header_size = 18;
+    const auto header = reinterpret_cast<const uint8_t*>(m_file.Data());
+    if (m_file.Size() < header_size)
+        ThrowDecodeError("file is shorter than its header");
+
+    const auto read_u16 = [header](const size_t offset) {
+        return static_cast<size_t>(header[offset] | (header[offset + 1] << 8));
+    };
+
+    const auto id_length = header[0];
+    const auto color_map_type = header[1];
+    const auto data_type = header[2];
+    const auto bits_per_pixel = header[16];
+    const auto descriptor = header[17];
+
+    if (color_map_type != 0)
+        ThrowDecodeError("color mapped images are not supported");
+
+    const auto grayscale = data_type == 3 || data_type == 11;
+    const auto true_color = data_type == 2 || data_type == 10;
+    if (!grayscale && !true_color)
+        ThrowDecodeError("unknown image type " + std::to_string(data_type));
+
+    if ((grayscale && bits_per_pixel != 8) || (true_color && bits_per_pixel != 24 && bits_per_pixel != 32))
+        ThrowDecodeError("bad bits per pixel value " + std::to_string(bits_per_pixel));
+
+    m_info = { read_u16(12), read_u16(14), static_cast<size_t>(bits_per_pixel >> 3) };
+    if (m_info.width == 0 || m_info.height == 0)
+        ThrowDecodeError("bad width/height value");
+
+    m_dataOffset = header_size + id_length;
+    if (m_dataOffset > m_file.Size())
+        ThrowDecodeError("image id runs past the end of file");
+
+    m_rle = data_type == 10 || data_type == 11;
+    m_topDown = (descriptor & 0x20) != 0;
+    m_rightToLeft = (descriptor & 0x10) != 0;
+}
+
+void TgaDecoder::Decode(const PixelView& out) const
+{
+    if (out.width != m_info.width || out.height != m_info.height)
+        throw std::runtime_error("Decode target doesn't match the .tga image size");
+
+    const auto begin = reinterpret_cast<const uint8_t*>(m_file.Data()) + m_dataOffset;
+    const auto end = reinterpret_cast<const uint8_t*>(m_file.Data()) + m_file.Size();
+    const auto source_bpp = m_info.bytesPerPixel;
+    const auto target_bpp = out.bytesPerPixel;
+
+    if (source_bpp == target_bpp && source_bpp == 1)
+        DecodePixels<1, 1>(begin, end, m_rle, m_topDown, out);
+    else if (source_bpp == target_bpp && source_bpp == 3)
+        DecodePixels<3, 3>(begin, end, m_rle, m_topDown, out);
+    else if (source_bpp == target_bpp && source_bpp == 4)
+        DecodePixels<4, 4>(begin, end, m_rle, m_topDown, out);
+    else if (source_bpp == 1 && target_bpp == 4)
+        DecodePixels<1, 4>(begin, end, m_rle, m_topDown, out);
+    else if (source_bpp == 3 && target_bpp == 4)
+        DecodePixels<3, 4>(begin, end, m_rle, m_topDown, out);
+    else
+        throw std::runtime_error("Unsupported decode target format");
+
+    // Right-to-left files are rare enough to be mirrored afterwards.
+    if (m_rightToLeft)
+    {
+        for (size_t y = 0; y < out.height; ++y)
+        {
+            for (size_t x = 0; x < out.width / 2; ++x)
+            {
+                std::swap_ranges(out.Pixel(static_cast<int32_t>(x), static_cast<int32_t>(y)),
+                    out.Pixel(static_cast<int32_t>(x + 1), static_cast<int32_t>(y)),
+                    out.Pixel(static_cast<int32_t>(out.width - 1 - x), static_cast<int32_t>(y)));
+            }
+        }
+    }
+}
+
+void WriteTga(const ConstPixelView& pixels, const std::filesystem::path& path_to_write, const bool rle, const size_t band_count)
+{
+    const uint8_t developer_area_ref[4] = { 0, 0, 0, 0 };
+    const uint8_t extension_area_ref[4] = { 0, 0, 0, 0 };
+    const uint8_t footer[18] = { 'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0' };
+    const auto grayscale = pixels.bytesPerPixel == TGAImage::GRAYSCALE;
+
+    if (!grayscale && pixels.bytesPerPixel != TGAImage::RGB && pixels.bytesPerPixel != TGAImage::RGBA)
+        throw std::runtime_error("Couldn't save file");
+
+    // The header holds 16-bit sizes; larger pictures need PPM or raw output.
+    if (pixels.width > 0xFFFF || pixels.height > 0xFFFF)
+        throw std::runtime_error("TGA can't hold images over 65535 pixels wide or high");
+
+    std::ofstream out(path_to_write, std::ios::binary);
+    if (!out.is_open())
+        throw std::runtime_error("Couldn't save file");
+
+    TGA_Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.bitsperpixel = static_cast<char>(pixels.bytesPerPixel << 3);
+    header.width = static_cast<short>(static_cast<uint16_t>(pixels.width));
+    header.height = static_cast<short>(static_cast<uint16_t>(pixels.height));
+    header.datatypecode = grayscale ? (rle ? 11 : 3) : (rle ? 10 : 2);
+    header.imagedescriptor = 0x20;
+    WriteBytes(out, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+    if (!rle)
+    {
+        const auto row_bytes = pixels.width * pixels.bytesPerPixel;
+        for (auto row = pixels.height; row-- > 0;)
+        {
+            WriteBytes(out, pixels.data + row * row_bytes, row_bytes);
+        }
+    }
+    else if (pixels.bytesPerPixel == TGAImage::GRAYSCALE)
+    {
+        WriteRle<TGAImage::GRAYSCALE>(out, pixels, band_count);
+    }
+    else if (pixels.bytesPerPixel == TGAImage::RGB)
+    {
+        WriteRle<TGAImage::RGB>(out, pixels, band_count);
+    }
+    else
+    {
+        WriteRle<TGAImage::RGBA>(out, pixels, band_count);
+    }
+
+    WriteBytes(out, developer_area_ref, sizeof(developer_area_ref));
+    WriteBytes(out, extension_area_ref, sizeof(extension_area_ref));
+    WriteBytes(out, footer, sizeof(footer));
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <filesystem>
+#include "img.hpp"
+#include "mappedfile.hpp"
+
+struct TgaInfo
+{
+    Width width;
+    Height height;
+    size_t bytesPerPixel;
+};
+
+// Maps a TGA file and validates its header on construction. Decode expands
+// raw or RLE pixel data straight into out with the first row at the top of
+// the picture, as TGAImage::read_tga_file leaves it. out either matches the
+// file's bytes per pixel or has 4, in which case missing channels are zero
+// and missing alpha is opaque.
+class TgaDecoder
+{
+    MappedFile m_file;
+    TgaInfo m_info;
+    size_t m_dataOffset;
+    bool m_rle;
+    bool m_topDown;
+    bool m_rightToLeft;
+
+public:
+    explicit TgaDecoder(const std::filesystem::path& path_to_read);
+
+    const TgaInfo& Info() const { return m_info; }
+    void Decode(const PixelView& out) const;
+};
+
+// Writes pixels, whose first row is the bottom of the picture, as a top-left
+// origin TGA file. Output is byte-identical to TGAImage::write_tga_file on a
+// vertically flipped copy, without making that copy. RLE is encoded in row
+// bands in parallel; band_count 0 picks one from image size and hardware.
+void WriteTga(const ConstPixelView& pixels,
+    const std::filesystem::path& path_to_write,
+    const bool rle = true,
+    const size_t band_count = 0);
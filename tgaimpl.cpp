@@ -1,4 +1,6 @@
 #include "tgaimpl.hpp"
+#include "tgacodec.hpp"
+#include <utility>
 
 RGBA TgaColor::ToRgba() const
 {
@@ -7,6 +9,13 @@ RGBA TgaColor::ToRgba() const
 
 void TgaImage::CreateImage(const Width width, const Height height)
 {
+    // Assigning a new TGAImage allocates twice and copies, so a same sized
+    // image is only cleared.
+    if (m_image.buffer() && GetImageSize() == ImageSize{ width, height } && m_image.get_bytespp() == TGAImage::RGB)
+    {
+        m_image.clear();
+        return;
+    }
     m_image = TGAImage{ static_cast<int>(width), static_cast<int>(height), TGAImage::RGB };
 }
 
@@ -15,14 +24,15 @@ void TgaImage::ReadImage(const std::filesystem::path& path_to_img)
     if (path_to_img.extension() != ".tga")
         throw std::runtime_error("Invalid file provided");
 
-    m_image.read_tga_file(path_to_img.string().c_str());
+    const TgaDecoder decoder(path_to_img);
+    const auto& info = decoder.Info();
+    m_image = TGAImage{ static_cast<int>(info.width), static_cast<int>(info.height), static_cast<int>(info.bytesPerPixel) };
+    decoder.Decode(GetPixels());
 }
 
 void TgaImage::WriteImage(const std::filesystem::path& path_to_write)
 {
-    m_image.flip_vertically();
-    if(!m_image.write_tga_file(path_to_write.string().c_str()))
-        throw std::runtime_error("Couldn't save file");
+    WriteTga(std::as_const(*this).GetPixels(), path_to_write);
 }
 
 ImageSize TgaImage::GetImageSize() const
@@ -42,3 +52,19 @@ void TgaImage::SetPixelColor(const int32_t x, const int32_t y, const float_t int
     const auto rgba = color.ToRgba();
     m_image.set(x, y, TGAColor{ rgba.r, rgba.g, rgba.b, rgba.a }*intensity);
 }
+
+PixelView TgaImage::GetPixels()
+{
+    return { m_image.buffer(),
+        static_cast<Width>(m_image.get_width()),
+        static_cast<Height>(m_image.get_height()),
+        static_cast<size_t>(m_image.get_bytespp()) };
+}
+
+ConstPixelView TgaImage::GetPixels() const
+{
+    return { m_image.buffer(),
+        static_cast<Width>(m_image.get_width()),
+        static_cast<Height>(m_image.get_height()),
+        static_cast<size_t>(m_image.get_bytespp()) };
+}
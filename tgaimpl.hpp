@@ -26,4 +26,6 @@ public:
     virtual ImageSize GetImageSize() const override;
     virtual std::unique_ptr<IColor> GetPixelColor(const int32_t x, const int32_t y) const override;
     virtual void SetPixelColor(const int32_t x, const int32_t y, const float_t intensity, const IColor& color) override;
+    virtual PixelView GetPixels() override;
+    virtual ConstPixelView GetPixels() const override;
 };
@@ -0,0 +1,73 @@
+#include "workerpool.hpp"
+
+void WorkerPool::Resize(const uint32_t thread_count)
+{
+    const auto threads = thread_count > 1 ? thread_count - size_t{ 1 } : 0;
+    if (threads == m_threads.size())
+        return;
+
+    Stop();
+    m_stopping = false;
+    for (size_t i = 0; i < threads; ++i)
+    {
+        m_threads.emplace_back(&WorkerPool::Work, this, m_generation);
+    }
+}
+
+void WorkerPool::Run(const void* worker, void (*call)(const void*))
+{
+    if (m_threads.empty())
+    {
+        call(worker);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_worker = worker;
+        m_call = call;
+        m_busy = m_threads.size();
+        ++m_generation;
+    }
+    m_started.notify_all();
+    call(worker);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [this] { return m_busy == 0; });
+}
+
+// Starts from the generation current when the thread was made, so a Run
+// issued before the thread first gets the lock isn't missed.
+void WorkerPool::Work(uint64_t seen)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_started.wait(lock, [this, seen] { return m_stopping || m_generation != seen; });
+        if (m_stopping)
+            return;
+
+        seen = m_generation;
+        const auto worker = m_worker;
+        const auto call = m_call;
+        lock.unlock();
+        call(worker);
+        lock.lock();
+        if (--m_busy == 0)
+            m_finished.notify_one();
+    }
+}
+
+void WorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_started.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+    m_threads.clear();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept across renders so running work on them doesn't start threads
+// or allocate. Run hands the same worker to every thread, the calling one
+// included, and returns once all of them are done with it.
+class WorkerPool
+{
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_started;
+    std::condition_variable m_finished;
+    const void* m_worker = nullptr;
+    void (*m_call)(const void*) = nullptr;
+    uint64_t m_generation = 0;
+    size_t m_busy = 0;
+    bool m_stopping = false;
+
+    void Run(const void* worker, void (*call)(const void*));
+    void Work(uint64_t seen);
+    void Stop();
+
+public:
+    WorkerPool() = default;
+    ~WorkerPool() { Stop(); }
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Keeps thread_count - 1 threads, as the caller of Run is the last one.
+    void Resize(const uint32_t thread_count);
+
+    template <typename WorkerFunc>
+    void Run(const WorkerFunc& worker)
+    {
+        Run(&worker, [](const void* func) { (*static_cast<const WorkerFunc*>(func))(); });
+    }
+};